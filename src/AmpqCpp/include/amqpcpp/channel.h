@@ -135,6 +135,17 @@ public:
         return _implementation->ready();
     }
 
+    /**
+     *  Is the channel waiting for the answer to a synchronous operation, or
+     *  still holding frames that were queued while it was waiting?
+     *  Local addition, see AmpqCpp/LOCAL_PATCHES.md
+     *  @return bool
+     */
+    bool waiting() const
+    {
+        return _implementation->waiting();
+    }
+
     /**
      *  Is the channel usable / not yet closed?
      *  @return bool
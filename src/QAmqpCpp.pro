@@ -11,12 +11,35 @@ CONFIG -= app_bundle
 
 
 SOURCES +=  \
+    QMqManager/QMqArchive.cpp \
+    QMqManager/QMqChunkAssembler.cpp \
+    QMqManager/QMqConnection.cpp \
+    QMqManager/QMqDedupCache.cpp \
+    QMqManager/QMqDeliveryBuffer.cpp \
+    QMqManager/QMqDnsCache.cpp \
+    QMqManager/QMqFrameEncoder.cpp \
+    QMqManager/QMqMetricsExporter.cpp \
+    QMqManager/QMqPublisher.cpp \
+    QMqManager/QMqShmRing.cpp \
+    QMqManager/QMqTimerWheel.cpp \
     QMqManager/QRabbitmqMgr.cpp \
     QMqManager/QTcpClient.cpp \
     QMqManager/QTcpConnectionHandler.cpp \
     main.cpp
 
 HEADERS += \
+    QMqManager/QMqArchive.h \
+    QMqManager/QMqChunkAssembler.h \
+    QMqManager/QMqConnection.h \
+    QMqManager/QMqDedupCache.h \
+    QMqManager/QMqDeliveryBuffer.h \
+    QMqManager/QMqDnsCache.h \
+    QMqManager/QMqFrameEncoder.h \
+    QMqManager/QMqMetricsExporter.h \
+    QMqManager/QMqPublisher.h \
+    QMqManager/QMqShmRing.h \
+    QMqManager/QMqStats.h \
+    QMqManager/QMqTimerWheel.h \
     QMqManager/QRabbitmqMgr.h \
     QMqManager/QTcpClient.h \
     QMqManager/QTcpConnectionHandler.h \
@@ -0,0 +1,480 @@
+#include "QMqArchive.h"
+#include <QDir>
+#include <QtGlobal>
+#include <chrono>
+#include <cstring>
+#include "amqpcpp.h"
+#if defined(Q_OS_UNIX) && !defined(Q_OS_DARWIN)
+#include <fcntl.h>
+#endif
+
+
+using namespace std;
+
+namespace AMQP_QT {
+
+namespace {
+
+const uint32_t ArchiveMagic = 0x514D5141;   // "QMQA"
+
+/**
+ * @brief The MqArchiveRecordHeader struct 每条记录的头，之后依次为exchange、routingKey、属性、body，按8字节对齐
+ */
+struct MqArchiveRecordHeader
+{
+    uint32_t magic;
+    uint32_t dataLen;       // 记录头之后的数据长度(不含对齐)
+    int64_t timestampUs;
+    uint32_t propertiesLen;
+    uint32_t bodyLen;
+    uint16_t exchangeLen;
+    uint16_t routingKeyLen;
+    uint8_t redelivered;
+    uint8_t reserved[3];
+};
+
+// 索引项，每条记录一项
+struct MqArchiveIndexEntry
+{
+    uint64_t sequence;
+    int64_t offset;
+    int64_t timestampUs;
+};
+
+/**
+ * @brief The MappedOutBuffer class 把AMQP-CPP的属性编码直接写入映射内存
+ */
+class MappedOutBuffer : public AMQP::OutBuffer
+{
+public:
+    explicit MappedOutBuffer(uchar *dest) : m_dest(dest) {}
+
+protected:
+    virtual void append(const void *data, size_t size) override
+    {
+        memcpy(m_dest, data, size);
+        m_dest += size;
+    }
+
+private:
+    uchar *m_dest;
+};
+
+qint64 AlignRecord(qint64 size)
+{
+    return (size + 7) & ~(qint64)7;
+}
+
+qint64 NowUs()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 实际分配磁盘块：resize只产生稀疏文件，磁盘写满时写映射内存会触发SIGBUS，预分配时空间不足即返回失败
+bool PreallocateFile(QFile &file, qint64 size, QString &error)
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_DARWIN)
+    int err = posix_fallocate(file.handle(), 0, size);
+    if (err != 0) {
+        error = QString(strerror(err));
+        return false;
+    }
+    return true;
+#else
+    // 没有posix_fallocate的平台逐块写零
+    if (!file.resize(size) || !file.seek(0)) {
+        error = file.errorString();
+        return false;
+    }
+    const QByteArray block(64 * 1024, '\0');
+    for (qint64 written = 0; written < size; ) {
+        qint64 chunk = qMin<qint64>(block.size(), size - written);
+        if (file.write(block.constData(), chunk) != chunk) {
+            error = file.errorString();
+            return false;
+        }
+        written += chunk;
+    }
+    if (!file.flush()) {
+        error = file.errorString();
+        return false;
+    }
+    return true;
+#endif
+}
+
+// 段文件名为起始序号，补零后按文件名排序即为序号顺序
+QString SegmentName(quint64 sequence)
+{
+    return QString("%1").arg(sequence, 20, 10, QChar('0'));
+}
+
+// 从映射内存的offset处解析一条完整记录，返回记录占用的字节数，无效时返回0
+qint64 ParseRecord(const uchar *map, qint64 mapSize, qint64 offset, MqArchiveRecordHeader &header)
+{
+    if (offset + (qint64)sizeof(header) > mapSize) {
+        return 0;
+    }
+    memcpy(&header, map + offset, sizeof(header));
+    if (header.magic != ArchiveMagic
+            || header.dataLen != (uint64_t)header.exchangeLen + header.routingKeyLen + header.propertiesLen + header.bodyLen) {
+        return 0;
+    }
+
+    qint64 recordSize = AlignRecord(sizeof(header) + header.dataLen);
+    return offset + recordSize <= mapSize ? recordSize : 0;
+}
+
+// 段中的有效记录数，写端异常退出时索引可能不完整，以段内容为准
+quint64 CountRecords(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return 0;
+    }
+    uchar *map = file.map(0, file.size());
+    if (!map) {
+        return 0;
+    }
+
+    quint64 count = 0;
+    qint64 offset = 0;
+    MqArchiveRecordHeader header;
+    while (qint64 recordSize = ParseRecord(map, file.size(), offset, header)) {
+        offset += recordSize;
+        count++;
+    }
+    file.unmap(map);
+    return count;
+}
+
+} //namespace
+
+
+QMqArchiveWriter::~QMqArchiveWriter()
+{
+    this->Close();
+}
+
+bool QMqArchiveWriter::Open(const QString &dir, qint64 segmentBytes)
+{
+    this->Close();
+    m_dir = dir;
+    m_segmentBytes = qMax<qint64>(segmentBytes, 1024 * 1024);
+    if (!QDir().mkpath(m_dir)) {
+        m_errMessage = "Open Archive Failed: cannot create " + m_dir;
+        return false;
+    }
+
+    // 已有日志时序号接着最后一段继续
+    m_sequence = 0;
+    QStringList segments = QDir(m_dir).entryList(QStringList() << "*.seg", QDir::Files, QDir::Name);
+    if (!segments.isEmpty()) {
+        QString last = segments.last();
+        quint64 base = last.left(last.size() - 4).toULongLong();
+        m_sequence = base + CountRecords(QDir(m_dir).filePath(last));
+    }
+
+    return this->OpenSegment(0);
+}
+
+void QMqArchiveWriter::Close()
+{
+    this->CloseSegment();
+}
+
+bool QMqArchiveWriter::isOpen() const
+{
+    return m_map != nullptr;
+}
+
+bool QMqArchiveWriter::Append(const AMQP::Message &message, bool redelivered)
+{
+    if (!m_map) {
+        m_errMessage = "Archive Append Failed: archive not open";
+        m_stats->failures.add();
+        return false;
+    }
+
+    const std::string &exchange = message.exchange();
+    const std::string &routingKey = message.routingkey();
+    // 超出记录头字段范围的消息无法完整写入，截断会破坏后续所有记录
+    uint64_t dataLen = (uint64_t)exchange.size() + routingKey.size() + message.size() + message.bodySize();
+    if (exchange.size() > 0xFFFF || routingKey.size() > 0xFFFF || dataLen > 0xFFFFFFFFULL) {
+        m_errMessage = "Archive Append Failed: record too large, exchange " + QString::number(exchange.size())
+                       + " routingKey " + QString::number(routingKey.size()) + " data " + QString::number(dataLen);
+        m_stats->failures.add();
+        return false;
+    }
+
+    MqArchiveRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ArchiveMagic;
+    header.timestampUs = NowUs();
+    header.propertiesLen = message.size();
+    header.bodyLen = (uint32_t)message.bodySize();
+    header.exchangeLen = (uint16_t)exchange.size();
+    header.routingKeyLen = (uint16_t)routingKey.size();
+    header.redelivered = redelivered ? 1 : 0;
+    header.dataLen = (uint32_t)dataLen;
+
+    // 放不下时轮转，超过段大小的消息单独占一段
+    qint64 recordSize = AlignRecord(sizeof(header) + header.dataLen);
+    if (m_offset + recordSize > m_mapSize) {
+        this->CloseSegment();
+        if (!this->OpenSegment(recordSize)) {
+            m_stats->failures.add();
+            return false;
+        }
+    }
+
+    // 索引先写，失败时不写入记录；QFile带缓冲，索引项攒满缓冲区才落盘
+    MqArchiveIndexEntry entry { m_sequence, m_offset, header.timestampUs };
+    if (m_index->write(reinterpret_cast<const char *>(&entry), sizeof(entry)) != (qint64)sizeof(entry)) {
+        m_errMessage = "Archive Append Failed: " + m_index->errorString();
+        m_stats->failures.add();
+        return false;
+    }
+
+    uchar *dest = m_map + m_offset;
+    memcpy(dest, &header, sizeof(header));
+    dest += sizeof(header);
+    memcpy(dest, exchange.data(), header.exchangeLen);
+    dest += header.exchangeLen;
+    memcpy(dest, routingKey.data(), header.routingKeyLen);
+    dest += header.routingKeyLen;
+    MappedOutBuffer properties(dest);
+    message.fill(properties);
+    dest += header.propertiesLen;
+    memcpy(dest, message.body(), header.bodyLen);
+
+    m_sequence++;
+    m_offset += recordSize;
+    m_stats->records.add();
+    m_stats->bytes.add(recordSize);
+    return true;
+}
+
+MqArchiveStats QMqArchiveWriter::getStats() const
+{
+    return *m_stats;
+}
+
+std::shared_ptr<const MqArchiveStats> QMqArchiveWriter::getSharedStats() const
+{
+    return m_stats;
+}
+
+QString QMqArchiveWriter::getErrorMessage() const
+{
+    return m_errMessage;
+}
+
+bool QMqArchiveWriter::OpenSegment(qint64 minBytes)
+{
+    qint64 size = qMax(m_segmentBytes, minBytes);
+    QString base = QDir(m_dir).filePath(SegmentName(m_sequence));
+
+    // 预分配整段并一次映射，写入时只有内存拷贝
+    m_segment = make_shared<QFile>(base + ".seg");
+    if (!m_segment->open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        m_errMessage = "Open Archive Segment Failed: " + m_segment->errorString();
+        m_segment = nullptr;
+        return false;
+    }
+    QString error;
+    if (!PreallocateFile(*m_segment, size, error)) {
+        m_errMessage = "Allocate Archive Segment Failed: " + error;
+        m_segment->close();
+        m_segment->remove();
+        m_segment = nullptr;
+        return false;
+    }
+    m_map = m_segment->map(0, size);
+    if (!m_map) {
+        m_errMessage = "Map Archive Segment Failed: " + m_segment->errorString();
+        m_segment->close();
+        m_segment->remove();
+        m_segment = nullptr;
+        return false;
+    }
+
+    m_index = make_shared<QFile>(base + ".idx");
+    if (!m_index->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_errMessage = "Open Archive Index Failed: " + m_index->errorString();
+        this->CloseSegment();
+        return false;
+    }
+
+    m_mapSize = size;
+    m_offset = 0;
+    m_stats->segments.add();
+    return true;
+}
+
+void QMqArchiveWriter::CloseSegment()
+{
+    if (m_segment) {
+        if (m_map) {
+            m_segment->unmap(m_map);
+        }
+        // 去掉预分配未使用的部分
+        m_segment->resize(m_offset);
+        m_segment->close();
+    }
+    if (m_index) {
+        m_index->close();
+    }
+
+    m_segment = nullptr;
+    m_index = nullptr;
+    m_map = nullptr;
+    m_mapSize = 0;
+    m_offset = 0;
+}
+
+
+QMqArchiveReader::~QMqArchiveReader()
+{
+    this->Close();
+}
+
+bool QMqArchiveReader::Open(const QString &dir)
+{
+    this->Close();
+    m_dir = dir;
+    m_segments.clear();
+    for (const QString &name : QDir(m_dir).entryList(QStringList() << "*.seg", QDir::Files, QDir::Name)) {
+        m_segments.append(name.left(name.size() - 4));
+    }
+    if (m_segments.isEmpty()) {
+        m_errMessage = "Open Archive Failed: no segment in " + m_dir;
+        return false;
+    }
+
+    return this->MapSegment(0);
+}
+
+void QMqArchiveReader::Close()
+{
+    this->UnmapSegment();
+    m_segmentIndex = -1;
+}
+
+bool QMqArchiveReader::SeekTime(qint64 timestampUs)
+{
+    for (int i = 0; i < m_segments.size(); i++) {
+        QFile index(QDir(m_dir).filePath(m_segments[i] + ".idx"));
+        qint64 count = index.open(QIODevice::ReadOnly) ? index.size() / (qint64)sizeof(MqArchiveIndexEntry) : 0;
+        uchar *map = count > 0 ? index.map(0, count * sizeof(MqArchiveIndexEntry)) : nullptr;
+        if (!map) {
+            continue;
+        }
+
+        // 段内按时间二分查找
+        const MqArchiveIndexEntry *entries = reinterpret_cast<const MqArchiveIndexEntry *>(map);
+        qint64 low = 0;
+        qint64 high = count;
+        while (low < high) {
+            qint64 mid = (low + high) / 2;
+            if (entries[mid].timestampUs < timestampUs) {
+                low = mid + 1;
+            }
+            else {
+                high = mid;
+            }
+        }
+
+        if (low < count) {
+            MqArchiveIndexEntry entry = entries[low];
+            index.unmap(map);
+            if (!this->MapSegment(i)) {
+                return false;
+            }
+            m_offset = entry.offset;
+            m_sequence = entry.sequence;
+            return true;
+        }
+        index.unmap(map);
+    }
+
+    // 全部早于该时间，定位到末尾
+    this->UnmapSegment();
+    m_segmentIndex = m_segments.size() - 1;
+    return true;
+}
+
+bool QMqArchiveReader::Next(MqArchiveRecord &record)
+{
+    while (m_segmentIndex >= 0) {
+        MqArchiveRecordHeader header;
+        qint64 recordSize = m_map ? ParseRecord(m_map, m_mapSize, m_offset, header) : 0;
+        if (recordSize > 0) {
+            const char *data = reinterpret_cast<const char *>(m_map + m_offset + sizeof(header));
+            record.sequence = m_sequence++;
+            record.timestampUs = header.timestampUs;
+            record.redelivered = header.redelivered != 0;
+            record.exchange = QByteArray::fromRawData(data, header.exchangeLen);
+            data += header.exchangeLen;
+            record.routingKey = QByteArray::fromRawData(data, header.routingKeyLen);
+            data += header.routingKeyLen;
+            record.properties = QByteArray::fromRawData(data, (int)header.propertiesLen);
+            data += header.propertiesLen;
+            record.body = QByteArray::fromRawData(data, (int)header.bodyLen);
+            m_offset += recordSize;
+            return true;
+        }
+
+        // 本段读完
+        if (m_segmentIndex + 1 >= m_segments.size() || !this->MapSegment(m_segmentIndex + 1)) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+QString QMqArchiveReader::getErrorMessage() const
+{
+    return m_errMessage;
+}
+
+bool QMqArchiveReader::MapSegment(int index)
+{
+    this->UnmapSegment();
+    m_segmentIndex = index;
+
+    m_segment = make_shared<QFile>(QDir(m_dir).filePath(m_segments[index] + ".seg"));
+    if (!m_segment->open(QIODevice::ReadOnly)) {
+        m_errMessage = "Open Archive Segment Failed: " + m_segment->errorString();
+        m_segment = nullptr;
+        return false;
+    }
+
+    // 空段没有可映射的内容，Next直接跳过
+    m_mapSize = m_segment->size();
+    if (m_mapSize > 0) {
+        m_map = m_segment->map(0, m_mapSize);
+        if (!m_map) {
+            m_errMessage = "Map Archive Segment Failed: " + m_segment->errorString();
+            return false;
+        }
+    }
+    m_offset = 0;
+    m_sequence = m_segments[index].toULongLong();
+    return true;
+}
+
+void QMqArchiveReader::UnmapSegment()
+{
+    if (m_segment && m_map) {
+        m_segment->unmap(m_map);
+    }
+    m_segment = nullptr;
+    m_map = nullptr;
+    m_mapSize = 0;
+    m_offset = 0;
+}
+
+
+} //namespace AMQP_QT
@@ -0,0 +1,127 @@
+#ifndef QMQARCHIVE_H
+#define QMQARCHIVE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QStringList>
+#include <memory>
+#include "QMqStats.h"
+
+
+namespace AMQP {
+class Message;
+}
+
+
+namespace AMQP_QT {
+
+// 回放配置
+typedef struct _mqreplayconfig
+{
+    double speed = 1.0;         // 按录制时的时间间隔回放的倍速，0表示不按原始间隔
+    int ratePerSec = 0;         // speed为0时每秒发送的消息数，0表示尽快发送
+    qint64 fromTimeUs = 0;      // 从该时间(微秒)起的消息开始回放，0表示从头开始
+    QString exchangeName = "";  // 非空时替换录制的exchange，routingKey保持不变
+    int batch = 256;            // 每次事件循环最多发送的消息数
+} MqReplayConfig;
+
+// 读取到的一条记录，数据直接引用映射的文件，在下一次Next之前有效
+typedef struct _mqarchiverecord
+{
+    quint64 sequence = 0;
+    qint64 timestampUs = 0;     // 录制时间
+    bool redelivered = false;
+    QByteArray exchange;
+    QByteArray routingKey;
+    QByteArray properties;      // 编码后的消息属性，与内容头帧中的属性部分一致
+    QByteArray body;
+} MqArchiveRecord;
+
+
+/**
+ * @brief The QMqArchiveWriter class 把收到的消息(属性+body)写入内存映射的追加日志
+ * 日志按段轮转，每段是用posix_fallocate预分配并整段映射的<起始序号>.seg文件，消息直接拷贝到映射内存中，
+ * 不产生逐条的内存分配；<起始序号>.idx记录每条消息的序号、段内偏移和时间，用于按时间定位，
+ * 经QFile缓冲写入，攒满缓冲区才落盘。超出记录头字段范围的消息不写入，Append返回false
+ */
+class QMqArchiveWriter
+{
+public:
+    QMqArchiveWriter() = default;
+    ~QMqArchiveWriter();
+
+    // 打开目录，已有日志时从最后的序号之后新开一段
+    bool Open(const QString &dir, qint64 segmentBytes = 256 * 1024 * 1024);
+    void Close();
+    bool isOpen() const;
+
+    bool Append(const AMQP::Message &message, bool redelivered);
+
+    MqArchiveStats getStats() const;
+    // 统计对象本身，供其他线程读取
+    std::shared_ptr<const MqArchiveStats> getSharedStats() const;
+    QString getErrorMessage() const;
+
+private:
+    bool OpenSegment(qint64 minBytes);
+    void CloseSegment();
+
+private:
+    QString m_dir;
+    qint64 m_segmentBytes = 0;
+    quint64 m_sequence = 0;         // 下一条消息的序号
+
+    std::shared_ptr<QFile> m_segment = nullptr;
+    std::shared_ptr<QFile> m_index = nullptr;
+    uchar *m_map = nullptr;
+    qint64 m_mapSize = 0;
+    qint64 m_offset = 0;
+
+    std::shared_ptr<MqArchiveStats> m_stats = std::make_shared<MqArchiveStats>();
+    QString m_errMessage;
+};
+
+
+/**
+ * @brief The QMqArchiveReader class 顺序读取QMqArchiveWriter写入的日志
+ * 每次只映射一段，读完后切换到下一段；写端未正常关闭时段尾是预分配的0，读到此处即视为该段结束
+ */
+class QMqArchiveReader
+{
+public:
+    QMqArchiveReader() = default;
+    ~QMqArchiveReader();
+
+    bool Open(const QString &dir);
+    void Close();
+
+    // 跳到第一条录制时间不早于timestampUs的消息
+    bool SeekTime(qint64 timestampUs);
+    // 读取下一条，没有更多消息时返回false
+    bool Next(MqArchiveRecord &record);
+
+    QString getErrorMessage() const;
+
+private:
+    bool MapSegment(int index);
+    void UnmapSegment();
+
+private:
+    QString m_dir;
+    QStringList m_segments;     // 按起始序号排序的段文件名(不含扩展名)
+    int m_segmentIndex = -1;
+
+    std::shared_ptr<QFile> m_segment = nullptr;
+    uchar *m_map = nullptr;
+    qint64 m_mapSize = 0;
+    qint64 m_offset = 0;
+    quint64 m_sequence = 0;     // 下一条记录的序号
+
+    QString m_errMessage;
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQARCHIVE_H
@@ -0,0 +1,202 @@
+#ifndef QMQBUSYPOLLHANDLER_H
+#define QMQBUSYPOLLHANDLER_H
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <vector>
+#include "amqpcpp.h"
+#include "amqpcpp/linux_tcp.h"
+#include "QMqStats.h"
+
+
+namespace AMQP_QT {
+
+// 忙轮询配置
+typedef struct _mqbusypollconfig
+{
+    int spinUs = 50;            // 没有事件时先空转的时间(微秒)，之后阻塞等待
+    int blockTimeoutMs = 100;   // 阻塞等待的超时，到时检查是否需要退出
+    int socketBusyPollUs = 0;   // 设置SO_BUSY_POLL(微秒)，由网卡驱动在recv时忙轮询，0表示不设置
+    int cpu = -1;               // Loop线程绑定的CPU，-1表示不绑定
+} MqBusyPollConfig;
+
+/**
+ * @brief The MqBusyPollStats struct 忙轮询统计
+ */
+struct MqBusyPollStats
+{
+    MqCounter spinWakeups;      // 空转期间发现事件的次数
+    MqCounter blockWakeups;     // 阻塞等待后发现事件的次数
+    MqCounter idleSpins;        // 空转预算用完仍无事件的次数
+    MqCounter heartbeats;       // 发出的心跳数
+};
+
+
+/**
+ * @brief The QMqBusyPollHandler class linux_tcp模块的低延迟事件循环
+ * 代替epoll/libev：在专用线程中调用Loop，没有事件时先以0超时poll空转spinUs，
+ * 仍无事件才阻塞poll，省去唤醒延迟，代价是空转期间占满一个CPU核。
+ * TcpConnection的创建、使用和Loop必须在同一线程；子类实现其余TcpHandler回调。
+ * 接受broker建议的心跳间隔，并在Loop中每半个间隔发送一次心跳；
+ * 子类重写onNegotiate时需调用本类的实现，或返回0关闭心跳
+ */
+class QMqBusyPollHandler : public AMQP::TcpHandler
+{
+public:
+    explicit QMqBusyPollHandler(const MqBusyPollConfig &config = MqBusyPollConfig()) : m_config(config) {}
+    virtual ~QMqBusyPollHandler() = default;
+
+    virtual uint16_t onNegotiate(AMQP::TcpConnection *connection, uint16_t interval) override
+    {
+        if (interval == 0) {
+            m_heartbeats.erase(connection);
+            return 0;
+        }
+        auto period = std::chrono::milliseconds(interval * 1000 / 2);
+        m_heartbeats[connection] = Heartbeat{period, std::chrono::steady_clock::now() + period};
+        return interval;
+    }
+
+    virtual void monitor(AMQP::TcpConnection *connection, int fd, int flags) override
+    {
+        if (flags == 0) {
+            m_watches.erase(fd);
+            // 连接不再有监听的socket时停止心跳
+            bool watched = false;
+            for (const auto &watch : m_watches) {
+                watched = watched || watch.second.connection == connection;
+            }
+            if (!watched) {
+                m_heartbeats.erase(connection);
+            }
+            return;
+        }
+
+        if (m_watches.find(fd) == m_watches.end() && m_config.socketBusyPollUs > 0) {
+            int busyPoll = m_config.socketBusyPollUs;
+            setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busyPoll, sizeof(busyPoll));
+        }
+        m_watches[fd] = Watch{connection, flags};
+    }
+
+    // 运行事件循环，直到Stop或不再有需要监听的socket
+    void Loop()
+    {
+        if (m_config.cpu >= 0) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(m_config.cpu, &cpus);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+
+        m_stop.store(false);
+        std::vector<pollfd> fds;
+        while (!m_stop.load(std::memory_order_relaxed) && !m_watches.empty()) {
+            fds.clear();
+            for (const auto &watch : m_watches) {
+                short events = 0;
+                if (watch.second.flags & AMQP::readable) events |= POLLIN;
+                if (watch.second.flags & AMQP::writable) events |= POLLOUT;
+                fds.push_back(pollfd{watch.first, events, 0});
+            }
+
+            int blockMs = this->SendHeartbeats();
+
+            // 先空转，预算用完再阻塞；被信号中断时重新开始
+            int ready = 0;
+            auto spinEnd = std::chrono::steady_clock::now() + std::chrono::microseconds(m_config.spinUs);
+            do {
+                ready = poll(fds.data(), fds.size(), 0);
+            } while ((ready == 0 || (ready < 0 && errno == EINTR)) && std::chrono::steady_clock::now() < spinEnd);
+
+            if (ready < 0) {
+                continue;
+            }
+            if (ready > 0) {
+                m_stats.spinWakeups.add();
+            }
+            else {
+                m_stats.idleSpins.add();
+                ready = poll(fds.data(), fds.size(), blockMs);
+                if (ready <= 0) {
+                    continue;
+                }
+                m_stats.blockWakeups.add();
+            }
+
+            for (const pollfd &fd : fds) {
+                if (fd.revents == 0) {
+                    continue;
+                }
+                // process中可能关闭连接并取消监听
+                auto iter = m_watches.find(fd.fd);
+                if (iter == m_watches.end()) {
+                    continue;
+                }
+                int flags = 0;
+                if (fd.revents & (POLLIN | POLLERR | POLLHUP)) flags |= AMQP::readable;
+                if (fd.revents & POLLOUT) flags |= AMQP::writable;
+                iter->second.connection->process(fd.fd, flags);
+            }
+        }
+    }
+
+    // 可在其他线程调用，Loop最迟在blockTimeoutMs后退出
+    void Stop()
+    {
+        m_stop.store(true);
+    }
+
+    MqBusyPollStats getStats() const
+    {
+        return m_stats;
+    }
+
+private:
+    // 发送到期的心跳，返回阻塞等待的超时(不晚于下一次心跳)
+    int SendHeartbeats()
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto next = now + std::chrono::milliseconds(m_config.blockTimeoutMs);
+        for (auto &item : m_heartbeats) {
+            Heartbeat &heartbeat = item.second;
+            if (heartbeat.due <= now) {
+                item.first->heartbeat();
+                m_stats.heartbeats.add();
+                heartbeat.due = now + heartbeat.period;
+            }
+            next = std::min(next, heartbeat.due);
+        }
+        return (int)std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+    }
+
+private:
+    struct Watch {
+        AMQP::TcpConnection *connection;
+        int flags;
+    };
+
+    struct Heartbeat {
+        std::chrono::steady_clock::duration period;
+        std::chrono::steady_clock::time_point due;
+    };
+
+    MqBusyPollConfig m_config;
+    std::map<int, Watch> m_watches;
+    std::map<AMQP::TcpConnection *, Heartbeat> m_heartbeats;
+    std::atomic<bool> m_stop { false };
+    MqBusyPollStats m_stats;
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQBUSYPOLLHANDLER_H
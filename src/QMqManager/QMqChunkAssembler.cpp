@@ -0,0 +1,342 @@
+#include "QMqChunkAssembler.h"
+#include <QDir>
+#include <QDebug>
+#include <climits>
+#include "amqpcpp.h"
+
+
+using namespace std;
+
+namespace AMQP_QT {
+
+QMqChunkAssembler::QMqChunkAssembler(QObject *parent)
+    : QObject(parent)
+{
+    m_clock.start();
+    connect(&m_timeoutTimer, &QTimer::timeout, this, &QMqChunkAssembler::OnCheckTimeout);
+    m_timeoutTimer.start(1000);
+}
+
+QMqChunkAssembler::~QMqChunkAssembler()
+{
+    m_timeoutTimer.stop();
+}
+
+void QMqChunkAssembler::setOutputDir(const QString &dir)
+{
+    m_outputDir = dir;
+    if (!m_outputDir.isEmpty()) {
+        QDir().mkpath(m_outputDir);
+    }
+}
+
+void QMqChunkAssembler::setTimeout(int timeoutMs)
+{
+    m_timeoutMs = timeoutMs;
+}
+
+void QMqChunkAssembler::setMaxTotalSize(qint64 bytes)
+{
+    m_maxTotalSize = bytes;
+}
+
+QString QMqChunkAssembler::getErrorMessage() const
+{
+    return m_errMessage;
+}
+
+bool QMqChunkAssembler::AppendChunk(const MqChunkInfo &info, const char *data, size_t size)
+{
+    try {
+        if (!this->CheckChunkHeader(info, size)) {
+            return false;
+        }
+        if (Crc32(data, size) != info.crc32) {
+            m_errMessage = "Append Chunk Failed: checksum mismatch, transfer: " + info.transferId
+                    + ", chunk: " + QString::number(info.index);
+            return false;
+        }
+
+        if (!m_transfers.contains(info.transferId)) {
+            Transfer transfer;
+            if (!this->OpenTransfer(info, transfer)) {
+                return false;
+            }
+            m_transfers.insert(info.transferId, transfer);
+        }
+
+        Transfer &transfer = m_transfers[info.transferId];
+        uint64_t stride = 0;
+        if (!this->CheckChunkLayout(transfer, info, size, stride)) {
+            return false;
+        }
+        transfer.stride = stride;
+        transfer.lastActiveMs = m_clock.elapsed();
+        if (transfer.received.at((int)info.index)) {
+            // 重复投递的分片，已经写入过，直接ack
+            return true;
+        }
+
+        if (!this->WriteChunk(transfer, info, data, size)) {
+            return false;
+        }
+
+        if (transfer.receivedCount == transfer.info.count) {
+            this->FinishTransfer(info.transferId);
+        }
+    }
+    catch (const std::exception &e) {
+        m_errMessage = "Append Chunk Failed: " + QString(e.what());
+        return false;
+    }
+
+    return true;
+}
+
+bool QMqChunkAssembler::CheckChunkHeader(const MqChunkInfo &info, size_t size)
+{
+    if (!IsValidTransferId(info.transferId)) {
+        m_errMessage = "Append Chunk Failed: invalid transferId";
+        return false;
+    }
+
+    // 分片头由发送端填写，先校验范围再分配任何内存或磁盘
+    uint64_t maxTotal = (uint64_t)m_maxTotalSize;
+    if (m_outputDir.isEmpty()) {
+        maxTotal = qMin<uint64_t>(maxTotal, INT_MAX);
+    }
+    if (info.totalSize == 0 || info.totalSize > maxTotal) {
+        m_errMessage = "Append Chunk Failed: total size out of range, transfer: " + info.transferId;
+        return false;
+    }
+    if (info.count == 0 || info.count > INT_MAX || info.count > info.totalSize || info.index >= info.count) {
+        m_errMessage = "Append Chunk Failed: invalid chunk count or index, transfer: " + info.transferId;
+        return false;
+    }
+    if (size == 0 || size > info.totalSize || info.offset > info.totalSize - size) {
+        m_errMessage = "Append Chunk Failed: chunk out of range, transfer: " + info.transferId;
+        return false;
+    }
+    return true;
+}
+
+bool QMqChunkAssembler::CheckChunkLayout(const Transfer &transfer, const MqChunkInfo &info, size_t size, uint64_t &stride)
+{
+    if (info.count != transfer.info.count || info.totalSize != transfer.info.totalSize) {
+        m_errMessage = "Append Chunk Failed: chunk count or total size differs from transfer: " + info.transferId;
+        return false;
+    }
+
+    // 除最后一片外每片大小相同，offset = index * stride，最后一片到totalSize为止
+    stride = transfer.stride;
+    bool last = info.index == info.count - 1;
+    if (stride == 0 && info.count > 1) {
+        if (!last) {
+            stride = size;
+        }
+        else if (info.offset % (info.count - 1) == 0) {
+            // 末尾分片先到时由它的offset推出分片大小，之后的分片(包括它自己)都按这个大小校验
+            stride = info.offset / (info.count - 1);
+        }
+        if (stride == 0 || stride > (info.totalSize - 1) / (info.count - 1)) {
+            m_errMessage = "Append Chunk Failed: chunk size inconsistent with count, transfer: " + info.transferId;
+            return false;
+        }
+    }
+
+    bool ok = true;
+    if (!last && size != stride) {
+        ok = false;
+    }
+    if (last && (info.offset + size != info.totalSize || (stride != 0 && size > stride))) {
+        ok = false;
+    }
+    if (stride != 0 && info.offset != (uint64_t)info.index * stride) {
+        ok = false;
+    }
+    if (info.count == 1 && info.offset != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        m_errMessage = "Append Chunk Failed: chunk offset inconsistent with transfer: " + info.transferId
+                + ", chunk: " + QString::number(info.index);
+    }
+    return ok;
+}
+
+bool QMqChunkAssembler::OpenTransfer(const MqChunkInfo &info, Transfer &transfer)
+{
+    transfer.info = info;
+    transfer.received = QByteArray((int)info.count, '\0');
+    transfer.lastActiveMs = m_clock.elapsed();
+
+    if (m_outputDir.isEmpty()) {
+        transfer.buffer.resize((int)info.totalSize);
+        return true;
+    }
+
+    QString path = QDir(m_outputDir).filePath(info.transferId);
+    transfer.file = make_shared<QFile>(path);
+    if (!transfer.file->open(QIODevice::ReadWrite) || !transfer.file->resize((qint64)info.totalSize)) {
+        m_errMessage = "Open Transfer Failed: " + transfer.file->errorString();
+        return false;
+    }
+
+    // 续传: 读取上次已写入的分片记录
+    QFile marks(path + ".chunks");
+    if (marks.open(QIODevice::ReadOnly)) {
+        QByteArray saved = marks.readAll();
+        if (saved.size() == transfer.received.size()) {
+            transfer.received = saved;
+            for (int i = 0; i < saved.size(); i++) {
+                transfer.receivedCount += saved.at(i) ? 1 : 0;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool QMqChunkAssembler::WriteChunk(Transfer &transfer, const MqChunkInfo &info, const char *data, size_t size)
+{
+    if (!transfer.file) {
+        memcpy(transfer.buffer.data() + info.offset, data, size);
+    }
+    else {
+        if (!transfer.file->seek((qint64)info.offset) || transfer.file->write(data, (qint64)size) != (qint64)size) {
+            m_errMessage = "Write Chunk Failed: " + transfer.file->errorString();
+            return false;
+        }
+        transfer.file->flush();
+    }
+
+    transfer.received.data()[(int)info.index] = 1;
+    transfer.receivedCount++;
+
+    if (transfer.file) {
+        QFile marks(transfer.file->fileName() + ".chunks");
+        if (marks.open(QIODevice::WriteOnly)) {
+            marks.write(transfer.received);
+        }
+    }
+
+    return true;
+}
+
+void QMqChunkAssembler::FinishTransfer(const QString &transferId)
+{
+    Transfer transfer = m_transfers.take(transferId);
+    if (!transfer.file) {
+        emit sigTransferCompleted(transferId, transfer.buffer);
+        return;
+    }
+
+    QString path = transfer.file->fileName();
+    transfer.file->close();
+    QFile::remove(path + ".chunks");
+    emit sigTransferFileReady(transferId, path);
+}
+
+QList<uint32_t> QMqChunkAssembler::MissingChunks(const Transfer &transfer) const
+{
+    QList<uint32_t> missing;
+    for (uint32_t i = 0; i < transfer.info.count; i++) {
+        if (!transfer.received.at((int)i)) {
+            missing.append(i);
+        }
+    }
+    return missing;
+}
+
+void QMqChunkAssembler::OnCheckTimeout()
+{
+    qint64 now = m_clock.elapsed();
+    QList<QString> expired;
+    for (auto it = m_transfers.begin(); it != m_transfers.end(); ++it) {
+        if (now - it.value().lastActiveMs > m_timeoutMs) {
+            expired.append(it.key());
+        }
+    }
+
+    for (const QString &transferId : expired) {
+        // 文件及分片记录保留，补发后可以继续
+        Transfer transfer = m_transfers.take(transferId);
+        if (transfer.file) {
+            transfer.file->close();
+        }
+        qCritical() << __FUNCTION__ << "chunk transfer timeout:" << transferId;
+        emit sigTransferFailed(transferId, "Transfer Timeout", this->MissingChunks(transfer));
+    }
+}
+
+bool QMqChunkAssembler::ParseChunkHeaders(const AMQP::MetaData &meta, MqChunkInfo &info)
+{
+    if (!meta.hasHeaders()) {
+        return false;
+    }
+
+    const AMQP::Table &headers = meta.headers();
+    if (!headers.contains(MqChunkTransferId) || !headers.contains(MqChunkIndex)) {
+        return false;
+    }
+
+    info.transferId = QString::fromStdString(headers.get(MqChunkTransferId));
+    info.index = headers.get(MqChunkIndex);
+    info.count = headers.get(MqChunkCount);
+    info.offset = headers.get(MqChunkOffset);
+    info.totalSize = headers.get(MqChunkTotalSize);
+    info.crc32 = headers.get(MqChunkCrc32);
+    return true;
+}
+
+void QMqChunkAssembler::FillChunkHeaders(const MqChunkInfo &info, AMQP::Table &headers)
+{
+    headers.set(MqChunkTransferId, info.transferId.toStdString());
+    headers.set(MqChunkIndex, info.index);
+    headers.set(MqChunkCount, info.count);
+    headers.set(MqChunkOffset, info.offset);
+    headers.set(MqChunkTotalSize, info.totalSize);
+    headers.set(MqChunkCrc32, info.crc32);
+}
+
+bool QMqChunkAssembler::IsValidTransferId(const QString &transferId)
+{
+    if (transferId.isEmpty() || transferId.size() > 64) {
+        return false;
+    }
+    // 非latin1字符转换后为'?'，同样被拒绝
+    for (char c : transferId.toLatin1()) {
+        bool ok = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-';
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t QMqChunkAssembler::Crc32(const char *data, size_t size)
+{
+    // 局部静态变量的初始化是线程安全的
+    static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+
+
+} //namespace AMQP_QT
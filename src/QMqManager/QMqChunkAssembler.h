@@ -0,0 +1,115 @@
+#ifndef QMQCHUNKASSEMBLER_H
+#define QMQCHUNKASSEMBLER_H
+
+#include <QObject>
+#include <QMap>
+#include <QFile>
+#include <QTimer>
+#include <QElapsedTimer>
+
+
+namespace AMQP {
+class MetaData;
+class Table;
+}
+
+
+namespace AMQP_QT {
+
+// 分片消息使用的header字段
+const char MqChunkTransferId[] = "x-transfer-id";
+const char MqChunkIndex[] = "x-chunk-index";
+const char MqChunkCount[] = "x-chunk-count";
+const char MqChunkOffset[] = "x-chunk-offset";
+const char MqChunkTotalSize[] = "x-total-size";
+const char MqChunkCrc32[] = "x-chunk-crc32";
+
+typedef struct _mqchunkinfo
+{
+    QString transferId;
+    uint32_t index = 0;
+    uint32_t count = 0;
+    uint64_t offset = 0;
+    uint64_t totalSize = 0;
+    uint32_t crc32 = 0;
+} MqChunkInfo;
+
+
+/**
+ * @brief The QMqChunkAssembler class 大消息分片的接收端重组
+ * 分片可能来自多个channel或queue，乱序到达；按offset写入预分配的内存或文件，
+ * 写入成功后由调用方ack。文件模式下已收到的分片记录在<文件名>.chunks中，进程重启后可续传
+ */
+class QMqChunkAssembler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QMqChunkAssembler(QObject *parent = nullptr);
+    ~QMqChunkAssembler();
+
+    // 设置输出目录，为空时在内存中重组
+    void setOutputDir(const QString &dir);
+    // 设置超时时间，单位ms，超时未收到新分片的传输视为失败
+    void setTimeout(int timeoutMs);
+    // 单个传输的大小上限，超过的分片直接拒绝，不分配内存或磁盘
+    void setMaxTotalSize(qint64 bytes);
+
+    // 处理一个分片，校验并写入成功返回true，此时可以ack该分片
+    bool AppendChunk(const MqChunkInfo &info, const char *data, size_t size);
+    // 获取错误信息
+    QString getErrorMessage() const;
+
+    // 从消息header解析分片信息，非分片消息返回false
+    static bool ParseChunkHeaders(const AMQP::MetaData &meta, MqChunkInfo &info);
+    // 填充分片header
+    static void FillChunkHeaders(const MqChunkInfo &info, AMQP::Table &headers);
+    static uint32_t Crc32(const char *data, size_t size);
+    // transferId用作文件名，只接受字母、数字和'-'(如UUID)
+    static bool IsValidTransferId(const QString &transferId);
+
+signals:
+    // 内存模式下传输完成
+    void sigTransferCompleted(const QString &transferId, const QByteArray &data);
+    // 文件模式下传输完成
+    void sigTransferFileReady(const QString &transferId, const QString &filePath);
+    // 传输超时或出错，missing为尚未收到的分片序号，可据此让发送端补发
+    void sigTransferFailed(const QString &transferId, const QString &reason, const QList<uint32_t> &missing);
+
+private slots:
+    void OnCheckTimeout();
+
+private:
+    struct Transfer {
+        MqChunkInfo info;
+        QByteArray buffer;              // 内存模式下预分配的缓冲区
+        std::shared_ptr<QFile> file;    // 文件模式下预分配的文件
+        QByteArray received;            // 每个分片一个字节，1表示已写入
+        uint32_t receivedCount = 0;
+        uint64_t stride = 0;            // 除最后一片外每片的大小，由第一个到达的分片确定(末尾分片按offset推出)
+        qint64 lastActiveMs = 0;
+    };
+
+    // 分片头自身是否合法
+    bool CheckChunkHeader(const MqChunkInfo &info, size_t size);
+    // 分片与已有传输是否一致，一致时返回本传输的分片大小
+    bool CheckChunkLayout(const Transfer &transfer, const MqChunkInfo &info, size_t size, uint64_t &stride);
+    bool OpenTransfer(const MqChunkInfo &info, Transfer &transfer);
+    bool WriteChunk(Transfer &transfer, const MqChunkInfo &info, const char *data, size_t size);
+    void FinishTransfer(const QString &transferId);
+    QList<uint32_t> MissingChunks(const Transfer &transfer) const;
+
+private:
+    QMap<QString, Transfer> m_transfers;
+    QString m_outputDir;
+    int m_timeoutMs = 60 * 1000;
+    qint64 m_maxTotalSize = 1024LL * 1024 * 1024;
+    QTimer m_timeoutTimer;
+    QElapsedTimer m_clock;
+    QString m_errMessage;
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQCHUNKASSEMBLER_H
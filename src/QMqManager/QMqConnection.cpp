@@ -0,0 +1,296 @@
+#include "QMqConnection.h"
+#include <QDebug>
+#include <QHash>
+#include <QList>
+#include <QCryptographicHash>
+#include "amqpcpp.h"
+#include "QTcpClient.h"
+#include "QTcpConnectionHandler.h"
+
+
+using namespace std;
+
+namespace AMQP_QT {
+
+QMqConnection::QMqConnection(const QString &host, uint16_t port, const QString &vhost,
+                             const QString &loginName, const QString &loginPwd, int hbInterval)
+    : QObject(nullptr), m_host(host), m_port(port), m_vhost(vhost),
+      m_loginName(loginName), m_loginPwd(loginPwd), m_heartbeatInterval(hbInterval)
+{
+    //
+}
+
+QMqConnection::~QMqConnection()
+{
+    this->Close();
+}
+
+void QMqConnection::setTlsConfig(const MqTlsConfig &tls)
+{
+    m_tls = tls;
+}
+
+bool QMqConnection::Open()
+{
+    try {
+        m_pTcpClient = make_shared<QTcpClient>(m_host, m_port);
+        m_pTcpClient->setTlsConfig(m_tls);
+        connect(m_pTcpClient.get(), &QTcpClient::sigParseTcpMsg, this, &QMqConnection::OnParseTcpMessage);
+        connect(m_pTcpClient.get(), &QTcpClient::sigSocketErr, this, &QMqConnection::OnTcpErrHandle);
+
+        // 建立tcp连接，域名还没有解析结果时在异步解析结束后继续连接，期间发出的帧排队等待
+        if (!m_pTcpClient->NewConnect()) {
+            m_errMessag = "Connect MqSever Failed";
+            return false;
+        }
+
+        // 创建handler对象
+        m_pHandler = make_shared<QTcpConnectionHandler>(m_pTcpClient);
+        m_pHandler->setHeartbeatInterval(m_heartbeatInterval); //设置心跳
+        connect(m_pHandler.get(), &QTcpConnectionHandler::sigStartHeartbeatTimer, this, &QMqConnection::OnStartHeartbeatTimer);
+
+        // 创建connection对象，开始登录Rmq
+        m_parseBuf.clear();
+        m_connection = std::make_shared<AMQP::Connection>(m_pHandler.get(),
+                                                          AMQP::Login(m_loginName.toStdString(), m_loginPwd.toStdString()),
+                                                          m_vhost.toStdString());
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Open Connection Failed: " + QString(e.what());
+        return false;
+    }
+
+    return true;
+}
+
+bool QMqConnection::Close()
+{
+    if (m_heartbeatTimer) {
+        m_heartbeatTimer->stop();
+    }
+
+    try {
+        if (m_connection && m_connection->usable()) {
+            bool ret = m_connection->close();
+            if (!ret) {
+                m_errMessag = "Closing Conncetion Failed";
+                return ret;
+            }
+        }
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Closing Conncetion Failed: " + QString(e.what());
+        return false;
+    }
+
+    return true;
+}
+
+std::shared_ptr<QTcpClient> QMqConnection::getTcpClient() const
+{
+    return m_pTcpClient;
+}
+
+std::shared_ptr<QTcpConnectionHandler> QMqConnection::getHandler() const
+{
+    return m_pHandler;
+}
+
+std::shared_ptr<AMQP::Connection> QMqConnection::getConnection() const
+{
+    return m_connection;
+}
+
+QString QMqConnection::getErrorMessage() const
+{
+    return m_errMessag;
+}
+
+QString QMqConnection::MakeKey(const QString &host, uint16_t port, const QString &vhost,
+                               const QString &loginName, const QString &loginPwd, const MqTlsConfig &tls)
+{
+    // 密码不以明文出现在key中
+    QByteArray pwdHash = QCryptographicHash::hash(loginPwd.toUtf8(), QCryptographicHash::Sha256).toHex();
+    QString key = QString(tls.enabled ? "amqps://" : "amqp://") + host + ":" + QString::number(port) + vhost + "|" + loginName + "|" + QString(pwdHash);
+    if (tls.enabled) {
+        key += "|verify=" + QString::number(tls.verifyPeer ? 1 : 0) + "|peer=" + tls.peerName + "|ca=" + tls.caCertFile
+                + "|resume=" + QString::number(tls.sessionResumption ? 1 : 0);
+    }
+    return key;
+}
+
+QString QMqConnection::getKey() const
+{
+    return MakeKey(m_host, m_port, m_vhost, m_loginName, m_loginPwd, m_tls);
+}
+
+void QMqConnection::AddUser(int channels)
+{
+    m_users++;
+    m_channels += channels;
+}
+
+void QMqConnection::RemoveUser(int channels)
+{
+    m_users = qMax(0, m_users - 1);
+    m_channels = qMax(0, m_channels - channels);
+}
+
+int QMqConnection::userCount() const
+{
+    return m_users;
+}
+
+int QMqConnection::channelCount() const
+{
+    return m_channels;
+}
+
+bool QMqConnection::isBroken() const
+{
+    return m_broken;
+}
+
+int QMqConnection::heartbeatInterval() const
+{
+    return m_pHandler ? m_pHandler->getHeartbeatInterval() : m_heartbeatInterval;
+}
+
+void QMqConnection::OnParseTcpMessage(const QByteArray &msg)
+{
+    if (!m_connection || !m_connection->usable()) {
+        return;
+    }
+
+    try {
+        // 一帧可能分多次到达，未解析完的数据留到下次
+        m_parseBuf.append(msg);
+        size_t parsed_bytes = 0;
+        size_t data_size = m_parseBuf.size();
+        // 解析过程中连接可能被关闭(如收到connection.close)，之后的数据不再交给它
+        while (m_connection && m_connection->usable() && data_size - parsed_bytes >= m_connection->expected()) {
+            size_t bytes = m_connection->parse(m_parseBuf.constData() + parsed_bytes, data_size - parsed_bytes);
+            if (bytes == 0) {
+                break;
+            }
+            parsed_bytes += bytes;
+        }
+
+        m_parseBuf.remove(0, (int)parsed_bytes);
+    }
+    catch (const std::exception&e) {
+        // 出错后无法确定帧边界，残留的数据不再拼接到下次读取的数据前
+        m_parseBuf.clear();
+        m_errMessag = "Parse MqData Error: " + QString(e.what());
+        qCritical() << __FUNCTION__ << "mq Error: " << m_errMessag;
+    }
+}
+
+void QMqConnection::OnStartHeartbeatTimer(int interval)
+{
+    qDebug() << __FUNCTION__ << " starts.";
+    if(m_heartbeatTimer && m_heartbeatTimer->isActive()) {
+        return;
+    }
+
+    m_heartbeatTimer = std::make_shared<QTimer>();
+    connect(m_heartbeatTimer.get(), &QTimer::timeout, [this]() {
+        if(!m_connection) { return; }
+        m_connection->heartbeat();
+    });
+
+    m_heartbeatTimer->start(1000*interval/3);
+}
+
+void QMqConnection::OnTcpErrHandle(const QString &err)
+{
+    m_errMessag = err;
+    m_broken = true;
+    if (m_heartbeatTimer) {
+        m_heartbeatTimer->stop();
+    }
+
+    emit sigSocketErr(err);
+}
+
+
+namespace {
+
+// 每个线程各自的共享连接表
+QHash<QString, QList<std::shared_ptr<QMqConnection>>> &SharedConnections()
+{
+    static thread_local QHash<QString, QList<std::shared_ptr<QMqConnection>>> connections;
+    return connections;
+}
+
+} //namespace
+
+std::shared_ptr<QMqConnection> QMqConnectionRegistry::Acquire(const QString &host, uint16_t port, const QString &vhost,
+                                                              const QString &loginName, const QString &loginPwd, const MqTlsConfig &tls,
+                                                              int hbInterval, int channels, int maxChannels, QString &err)
+{
+    QString key = QMqConnection::MakeKey(host, port, vhost, loginName, loginPwd, tls);
+    QList<std::shared_ptr<QMqConnection>> &list = SharedConnections()[key];
+
+    for (const std::shared_ptr<QMqConnection> &conn : list) {
+        if (conn->isBroken()) {
+            continue;
+        }
+        // 心跳在登录时确定，之后无法修改：需要心跳的实例只共用心跳不长于所需间隔的连接，
+        // 不需要心跳的实例(如发布端)可以共用任何连接
+        if (hbInterval > 0 && (conn->heartbeatInterval() == 0 || conn->heartbeatInterval() > hbInterval)) {
+            continue;
+        }
+        if (maxChannels <= 0 || conn->channelCount() + channels <= maxChannels) {
+            conn->AddUser(channels);
+            return conn;
+        }
+    }
+
+    // 新连接使用本实例的心跳间隔
+    std::shared_ptr<QMqConnection> conn = make_shared<QMqConnection>(host, port, vhost, loginName, loginPwd, hbInterval);
+    conn->setTlsConfig(tls);
+    if (!conn->Open()) {
+        err = conn->getErrorMessage();
+        if (list.isEmpty()) {
+            SharedConnections().remove(key);
+        }
+        return nullptr;
+    }
+
+    conn->AddUser(channels);
+    list.append(conn);
+    return conn;
+}
+
+void QMqConnectionRegistry::Release(const std::shared_ptr<QMqConnection> &conn, int channels)
+{
+    if (!conn) {
+        return;
+    }
+
+    conn->RemoveUser(channels);
+    if (conn->userCount() > 0) {
+        return;
+    }
+
+    conn->Close();
+    QString key = conn->getKey();
+    QList<std::shared_ptr<QMqConnection>> &list = SharedConnections()[key];
+    list.removeAll(conn);
+    if (list.isEmpty()) {
+        SharedConnections().remove(key);
+    }
+}
+
+int QMqConnectionRegistry::connectionCount()
+{
+    int count = 0;
+    for (const QList<std::shared_ptr<QMqConnection>> &list : SharedConnections()) {
+        count += list.size();
+    }
+    return count;
+}
+
+
+} //namespace AMQP_QT
@@ -0,0 +1,114 @@
+#ifndef QMQCONNECTION_H
+#define QMQCONNECTION_H
+
+#include <QObject>
+#include <QTimer>
+#include <QByteArray>
+#include <memory>
+#include "QTcpClient.h"
+
+
+namespace AMQP {
+class Connection;
+}
+
+
+namespace AMQP_QT {
+
+class QTcpConnectionHandler;
+
+
+/**
+ * @brief The QMqConnection class 一条到broker的连接：tcp、handler、AMQP::Connection及心跳
+ * 可以由单个QRabbitmqMgr独占，也可以通过QMqConnectionRegistry由多个实例共享，
+ * 各实例在同一连接上创建自己的channel
+ */
+class QMqConnection : public QObject
+{
+    Q_OBJECT
+public:
+    QMqConnection(const QString &host, uint16_t port, const QString &vhost,
+                  const QString &loginName, const QString &loginPwd, int hbInterval = 0);
+    ~QMqConnection();
+
+    // 启用TLS时在Open之前调用
+    void setTlsConfig(const MqTlsConfig &tls);
+    // 建立tcp连接并开始登录
+    bool Open();
+    bool Close();
+
+    std::shared_ptr<QTcpClient> getTcpClient() const;
+    std::shared_ptr<QTcpConnectionHandler> getHandler() const;
+    std::shared_ptr<AMQP::Connection> getConnection() const;
+    QString getErrorMessage() const;
+
+    // 共享时的key：endpoint + vhost + 登录信息 + 全部TLS配置，校验要求不同的实例不会共用连接
+    static QString MakeKey(const QString &host, uint16_t port, const QString &vhost,
+                           const QString &loginName, const QString &loginPwd, const MqTlsConfig &tls);
+    QString getKey() const;
+
+    // 使用者及其占用的channel数
+    void AddUser(int channels);
+    void RemoveUser(int channels);
+    int userCount() const;
+    int channelCount() const;
+    // 连接出错后不再分配给新的使用者
+    bool isBroken() const;
+    // 登录时与broker协商后的心跳间隔，协商完成前为请求的间隔(协商结果不会大于它)，0表示无心跳
+    int heartbeatInterval() const;
+
+signals:
+    void sigSocketErr(const QString &err);
+
+private slots:
+    // 收到的数据交给AMQP::Connection解析，请勿进行耗时操作
+    void OnParseTcpMessage(const QByteArray &msg);
+    // 若设置心跳，发送心跳数据
+    void OnStartHeartbeatTimer(int interval);
+    void OnTcpErrHandle(const QString &err);
+
+private:
+    QString m_host;
+    uint16_t m_port = 5672;
+    QString m_vhost;
+    QString m_loginName;
+    QString m_loginPwd;
+    int m_heartbeatInterval = 0;    //心跳时间，单位:秒
+    MqTlsConfig m_tls;
+
+    std::shared_ptr<QTcpClient> m_pTcpClient = nullptr;
+    std::shared_ptr<QTcpConnectionHandler> m_pHandler = nullptr;
+    std::shared_ptr<AMQP::Connection> m_connection = nullptr;
+    std::shared_ptr<QTimer> m_heartbeatTimer = nullptr;
+    QByteArray m_parseBuf;      // 未解析完的数据，跨多次socket读取
+
+    int m_users = 0;
+    int m_channels = 0;
+    bool m_broken = false;
+    QString m_errMessag;
+};
+
+
+/**
+ * @brief The QMqConnectionRegistry class 按key共享连接，引用计数归零时关闭
+ * 每个连接上的channel数不超过上限，超过时新建连接。
+ * AMQP::Connection非线程安全，共享只发生在同一线程内的实例之间
+ */
+class QMqConnectionRegistry
+{
+public:
+    // 获取可用的共享连接，没有时新建；失败返回nullptr，错误信息写入err
+    static std::shared_ptr<QMqConnection> Acquire(const QString &host, uint16_t port, const QString &vhost,
+                                                  const QString &loginName, const QString &loginPwd, const MqTlsConfig &tls,
+                                                  int hbInterval, int channels, int maxChannels, QString &err);
+    // 归还连接，最后一个使用者归还时关闭连接
+    static void Release(const std::shared_ptr<QMqConnection> &conn, int channels);
+    // 当前线程中的共享连接数
+    static int connectionCount();
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQCONNECTION_H
@@ -0,0 +1,204 @@
+#include "QMqDedupCache.h"
+#include <cstring>
+#include "amqpcpp.h"
+
+
+using namespace std;
+
+namespace AMQP_QT {
+
+namespace {
+
+const uint32_t DedupMagic = 0x514D5144;     // "QMQD"
+const int BloomBitsPerKey = 10;
+const int BloomHashes = 7;
+
+uint64_t Fnv1a(const char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+} //namespace
+
+
+struct MqDedupHeader
+{
+    uint32_t magic;
+    uint32_t window;
+    uint64_t head;      // 下一条记录写入的位置，窗口满时即最早的记录
+    uint64_t count;
+};
+
+
+QMqDedupCache::QMqDedupCache(int window)
+    : m_window(qMax(1, window))
+{
+    m_memHeader = make_shared<MqDedupHeader>();
+    m_memHeader->magic = DedupMagic;
+    m_memHeader->window = (uint32_t)m_window;
+    m_memHeader->head = 0;
+    m_memHeader->count = 0;
+    m_memRing.assign(m_window, 0);
+    m_header = m_memHeader.get();
+    m_ring = m_memRing.data();
+
+    size_t words = ((size_t)m_window * BloomBitsPerKey + 63) / 64;
+    m_bloom[0].assign(words, 0);
+    m_bloom[1].assign(words, 0);
+}
+
+QMqDedupCache::~QMqDedupCache()
+{
+    if (m_file && m_map) {
+        m_file->unmap(m_map);
+    }
+}
+
+bool QMqDedupCache::OpenPersist(const QString &path)
+{
+    qint64 size = (qint64)sizeof(MqDedupHeader) + (qint64)m_window * sizeof(uint64_t);
+    std::shared_ptr<QFile> file = make_shared<QFile>(path);
+    if (!file->open(QIODevice::ReadWrite)) {
+        m_errMessage = "Open Dedup File Failed: " + file->errorString();
+        return false;
+    }
+
+    // 窗口大小不同的旧文件无法沿用，重新初始化
+    bool reuse = file->size() == size;
+    if (!reuse && !file->resize(size)) {
+        m_errMessage = "Resize Dedup File Failed: " + file->errorString();
+        return false;
+    }
+    uchar *map = file->map(0, size);
+    if (!map) {
+        m_errMessage = "Map Dedup File Failed: " + file->errorString();
+        return false;
+    }
+
+    MqDedupHeader *header = reinterpret_cast<MqDedupHeader *>(map);
+    if (!reuse || header->magic != DedupMagic || header->window != (uint32_t)m_window
+            || header->head >= (uint64_t)m_window || header->count > (uint64_t)m_window) {
+        memset(map, 0, size);
+        header->magic = DedupMagic;
+        header->window = (uint32_t)m_window;
+    }
+
+    m_file = file;
+    m_map = map;
+    m_header = header;
+    m_ring = reinterpret_cast<uint64_t *>(map + sizeof(MqDedupHeader));
+    this->Load();
+    return true;
+}
+
+uint64_t QMqDedupCache::MakeKey(const AMQP::MetaData &meta, const char *body, size_t size)
+{
+    uint64_t key = meta.hasMessageID() ? Fnv1a(meta.messageID().data(), meta.messageID().size()) : Fnv1a(body, size);
+    // 0用作空位标记
+    return key == 0 ? 1 : key;
+}
+
+bool QMqDedupCache::contains(uint64_t key) const
+{
+    if (key == 0 || !this->BloomMayContain(key)) {
+        return false;
+    }
+    return m_index.contains(key);
+}
+
+void QMqDedupCache::insert(uint64_t key)
+{
+    if (key == 0) {
+        return;
+    }
+
+    // 窗口已满时覆盖最早的记录
+    uint64_t &slot = m_ring[m_header->head];
+    if (m_header->count == (uint64_t)m_window) {
+        auto iter = m_index.find(slot);
+        if (iter != m_index.end() && --iter.value() <= 0) {
+            m_index.erase(iter);
+        }
+    }
+    else {
+        m_header->count++;
+    }
+
+    slot = key;
+    m_header->head = (m_header->head + 1) % m_window;
+    m_index[key]++;
+    this->BloomAdd(key);
+}
+
+int QMqDedupCache::size() const
+{
+    return (int)m_header->count;
+}
+
+QString QMqDedupCache::getErrorMessage() const
+{
+    return m_errMessage;
+}
+
+void QMqDedupCache::Load()
+{
+    m_index.clear();
+    m_bloom[0].assign(m_bloom[0].size(), 0);
+    m_bloom[1].assign(m_bloom[1].size(), 0);
+    m_bloomCurrent = 0;
+    m_bloomInserted = 0;
+
+    // 从最早的记录开始重建索引和过滤器
+    uint64_t start = (m_header->head + m_window - m_header->count) % m_window;
+    for (uint64_t i = 0; i < m_header->count; i++) {
+        uint64_t key = m_ring[(start + i) % m_window];
+        m_index[key]++;
+        this->BloomAdd(key);
+    }
+}
+
+void QMqDedupCache::BloomAdd(uint64_t key)
+{
+    // 当前一代写满时清空较旧的一代并切换，两代合起来始终覆盖整个窗口
+    if (m_bloomInserted >= m_window) {
+        m_bloomCurrent = 1 - m_bloomCurrent;
+        m_bloom[m_bloomCurrent].assign(m_bloom[m_bloomCurrent].size(), 0);
+        m_bloomInserted = 0;
+    }
+
+    std::vector<uint64_t> &bits = m_bloom[m_bloomCurrent];
+    uint64_t total = bits.size() * 64;
+    uint64_t h1 = key;
+    uint64_t h2 = (key >> 33) | 1;
+    for (int i = 0; i < BloomHashes; i++) {
+        uint64_t bit = (h1 + i * h2) % total;
+        bits[bit / 64] |= 1ULL << (bit % 64);
+    }
+    m_bloomInserted++;
+}
+
+bool QMqDedupCache::BloomMayContain(uint64_t key) const
+{
+    uint64_t h1 = key;
+    uint64_t h2 = (key >> 33) | 1;
+    for (const std::vector<uint64_t> &bits : m_bloom) {
+        uint64_t total = bits.size() * 64;
+        bool hit = true;
+        for (int i = 0; i < BloomHashes && hit; i++) {
+            uint64_t bit = (h1 + i * h2) % total;
+            hit = (bits[bit / 64] >> (bit % 64)) & 1;
+        }
+        if (hit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+} //namespace AMQP_QT
@@ -0,0 +1,70 @@
+#ifndef QMQDEDUPCACHE_H
+#define QMQDEDUPCACHE_H
+
+#include <QFile>
+#include <QHash>
+#include <memory>
+#include <vector>
+
+
+namespace AMQP {
+class MetaData;
+}
+
+
+namespace AMQP_QT {
+
+struct MqDedupHeader;
+
+
+/**
+ * @brief The QMqDedupCache class 已处理消息的去重窗口
+ * 记录最近window条消息的64位指纹(messageID，没有时为body哈希)，超出窗口时淘汰最早的记录。
+ * 查询先经过两代轮换的布隆过滤器，绝大多数新消息在这一步即可确定未出现过；
+ * 过滤器命中后再查精确索引，因此不会把未处理过的消息误判为重复。
+ * 可把窗口映射到文件，进程崩溃重启后仍能识别崩溃前已处理、但ack未送达的消息
+ */
+class QMqDedupCache
+{
+public:
+    explicit QMqDedupCache(int window = 100000);
+    ~QMqDedupCache();
+
+    // 把窗口映射到文件，文件中已有相同大小的窗口时载入其中的记录
+    bool OpenPersist(const QString &path);
+
+    // 消息指纹，0表示无法计算
+    static uint64_t MakeKey(const AMQP::MetaData &meta, const char *body, size_t size);
+
+    bool contains(uint64_t key) const;
+    void insert(uint64_t key);
+    int size() const;
+    QString getErrorMessage() const;
+
+private:
+    void Load();
+    void BloomAdd(uint64_t key);
+    bool BloomMayContain(uint64_t key) const;
+
+private:
+    int m_window = 0;
+    MqDedupHeader *m_header = nullptr;  // 指向m_memHeader或映射的文件头
+    uint64_t *m_ring = nullptr;         // 指向m_memRing或映射的文件
+    std::shared_ptr<MqDedupHeader> m_memHeader;
+    std::vector<uint64_t> m_memRing;
+    QHash<uint64_t, int> m_index;       // 指纹 -> 在窗口中出现的次数
+
+    std::vector<uint64_t> m_bloom[2];   // 两代过滤器，每代容纳window条，满后清空较旧的一代
+    int m_bloomCurrent = 0;
+    int m_bloomInserted = 0;
+
+    std::shared_ptr<QFile> m_file = nullptr;
+    uchar *m_map = nullptr;
+    QString m_errMessage;
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQDEDUPCACHE_H
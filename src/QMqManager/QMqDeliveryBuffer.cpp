@@ -0,0 +1,247 @@
+#include "QMqDeliveryBuffer.h"
+
+
+namespace AMQP_QT {
+
+void QMqDeliveryBuffer::setWatermarks(qint64 highBytes, qint64 lowBytes, int highMessages, int lowMessages)
+{
+    m_highBytes = highBytes;
+    m_lowBytes = qMin(lowBytes, highBytes);
+    m_highMessages = highMessages;
+    m_lowMessages = qMin(lowMessages, highMessages);
+}
+
+void QMqDeliveryBuffer::setQueueWeights(const QVector<int> &weights, MqSchedulePolicy policy)
+{
+    int count = qMax(1, weights.size());
+    m_queues.resize(count);
+    m_queueSizes.fill(0, count);
+    for (QVector<QQueue<MqDelivery>> &levels : m_queues) {
+        levels.resize(m_priorityLevels);
+    }
+    m_weights.fill(1, count);
+    m_currentWeights.fill(0, count);
+    for (int i = 0; i < weights.size(); i++) {
+        m_weights[i] = qMax(1, weights[i]);
+    }
+    m_policy = policy;
+}
+
+void QMqDeliveryBuffer::setPriorityLevels(int levels)
+{
+    m_priorityLevels = qBound(1, levels, 256);
+    for (QVector<QQueue<MqDelivery>> &queueLevels : m_queues) {
+        queueLevels.resize(m_priorityLevels);
+    }
+}
+
+void QMqDeliveryBuffer::push(MqDelivery &&delivery)
+{
+    int index = this->QueueIndex(delivery);
+    int level = this->PriorityLevel(delivery);
+    m_bufferedBytes += delivery.body.size();
+    m_bufferedMessages++;
+    m_queueSizes[index]++;
+    m_queues[index][level].enqueue(std::move(delivery));
+}
+
+int QMqDeliveryBuffer::PriorityLevel(const MqDelivery &delivery) const
+{
+    if (m_priorityLevels <= 1 || !delivery.meta.hasPriority()) {
+        return 0;
+    }
+    return qMin((int)delivery.meta.priority(), m_priorityLevels - 1);
+}
+
+int QMqDeliveryBuffer::QueueIndex(const MqDelivery &delivery) const
+{
+    return (delivery.queueIndex >= 0 && delivery.queueIndex < m_queues.size()) ? delivery.queueIndex : 0;
+}
+
+QString QMqDeliveryBuffer::ConflationSlot(const MqDelivery &delivery)
+{
+    return QString::number(delivery.queueIndex) + ":" + delivery.conflationKey;
+}
+
+MqDelivery QMqDeliveryBuffer::Placeholder(const MqDelivery &delivery)
+{
+    MqDelivery placeholder;
+    placeholder.placeholder = true;
+    placeholder.conflationKey = delivery.conflationKey;
+    placeholder.queueIndex = delivery.queueIndex;
+    if (delivery.meta.hasPriority()) {
+        placeholder.meta.setPriority(delivery.meta.priority());
+    }
+    return placeholder;
+}
+
+bool QMqDeliveryBuffer::pushConflated(MqDelivery &&delivery, uint64_t &supersededTag)
+{
+    if (delivery.conflationKey.isEmpty()) {
+        this->push(std::move(delivery));
+        return false;
+    }
+
+    QString slot = ConflationSlot(delivery);
+    auto it = m_conflated.find(slot);
+    if (it != m_conflated.end()) {
+        MqDelivery &queued = it.value();
+        supersededTag = queued.deliveryTag;
+        m_bufferedBytes += delivery.body.size() - queued.body.size();
+        int oldLevel = this->PriorityLevel(queued);
+        int newLevel = this->PriorityLevel(delivery);
+        queued = std::move(delivery);
+
+        // 优先级变化时占位移到新优先级的队尾，消息数不变
+        if (newLevel != oldLevel) {
+            QQueue<MqDelivery> &levelQueue = m_queues[this->QueueIndex(queued)][oldLevel];
+            for (int i = 0; i < levelQueue.size(); i++) {
+                if (levelQueue[i].placeholder && levelQueue[i].conflationKey == queued.conflationKey) {
+                    levelQueue.removeAt(i);
+                    break;
+                }
+            }
+            m_queues[this->QueueIndex(queued)][newLevel].enqueue(Placeholder(queued));
+        }
+        return true;
+    }
+
+    // 队列中放只带key的占位，出队时取最新内容
+    MqDelivery placeholder = Placeholder(delivery);
+    qint64 bytes = delivery.body.size();
+    m_conflated.insert(slot, std::move(delivery));
+    this->push(std::move(placeholder));
+    m_bufferedBytes += bytes;
+    return false;
+}
+
+MqDelivery QMqDeliveryBuffer::pop()
+{
+    // 同一来源队列中先取优先级高的
+    int index = this->SelectQueue();
+    QVector<QQueue<MqDelivery>> &levels = m_queues[index];
+    int level = levels.size() - 1;
+    while (level > 0 && levels[level].isEmpty()) {
+        level--;
+    }
+    MqDelivery delivery = levels[level].dequeue();
+    m_queueSizes[index]--;
+    if (delivery.placeholder) {
+        delivery = m_conflated.take(ConflationSlot(delivery));
+    }
+    m_bufferedBytes -= delivery.body.size();
+    m_bufferedMessages--;
+    return delivery;
+}
+
+int QMqDeliveryBuffer::SelectQueue()
+{
+    if (m_queues.size() == 1) {
+        return 0;
+    }
+
+    int selected = -1;
+    if (m_policy == MqScheduleStrict) {
+        for (int i = 0; i < m_queues.size(); i++) {
+            if (m_queueSizes[i] > 0 && (selected < 0 || m_weights[i] > m_weights[selected])) {
+                selected = i;
+            }
+        }
+        return selected;
+    }
+
+    // 平滑加权轮询：非空队列累加权重，选最大者并减去总权重
+    qint64 total = 0;
+    for (int i = 0; i < m_queues.size(); i++) {
+        if (m_queueSizes[i] == 0) {
+            continue;
+        }
+        m_currentWeights[i] += m_weights[i];
+        total += m_weights[i];
+        if (selected < 0 || m_currentWeights[i] > m_currentWeights[selected]) {
+            selected = i;
+        }
+    }
+    m_currentWeights[selected] -= total;
+    return selected;
+}
+
+bool QMqDeliveryBuffer::isEmpty() const
+{
+    return m_bufferedMessages == 0;
+}
+
+int QMqDeliveryBuffer::clear()
+{
+    int count = m_bufferedMessages;
+    for (int i = 0; i < m_queues.size(); i++) {
+        for (QQueue<MqDelivery> &level : m_queues[i]) {
+            level.clear();
+        }
+        m_queueSizes[i] = 0;
+        m_currentWeights[i] = 0;
+    }
+    m_conflated.clear();
+    m_bufferedMessages = 0;
+    m_bufferedBytes = 0;
+    m_unackedBytes = 0;
+    m_unackedMessages = 0;
+    return count;
+}
+
+void QMqDeliveryBuffer::addUnacked(qint64 bytes)
+{
+    m_unackedBytes += bytes;
+    m_unackedMessages++;
+}
+
+void QMqDeliveryBuffer::removeUnacked(qint64 bytes)
+{
+    m_unackedBytes = qMax<qint64>(0, m_unackedBytes - bytes);
+    m_unackedMessages = qMax(0, m_unackedMessages - 1);
+}
+
+bool QMqDeliveryBuffer::aboveHighWatermark() const
+{
+    if (m_highBytes > 0 && m_bufferedBytes + m_unackedBytes >= m_highBytes) {
+        return true;
+    }
+    if (m_highMessages > 0 && m_bufferedMessages + m_unackedMessages >= m_highMessages) {
+        return true;
+    }
+    return false;
+}
+
+bool QMqDeliveryBuffer::belowLowWatermark() const
+{
+    if (m_highBytes > 0 && m_bufferedBytes + m_unackedBytes > m_lowBytes) {
+        return false;
+    }
+    if (m_highMessages > 0 && m_bufferedMessages + m_unackedMessages > m_lowMessages) {
+        return false;
+    }
+    return true;
+}
+
+int QMqDeliveryBuffer::bufferedMessages() const
+{
+    return m_bufferedMessages;
+}
+
+qint64 QMqDeliveryBuffer::bufferedBytes() const
+{
+    return m_bufferedBytes;
+}
+
+int QMqDeliveryBuffer::unackedMessages() const
+{
+    return m_unackedMessages;
+}
+
+qint64 QMqDeliveryBuffer::unackedBytes() const
+{
+    return m_unackedBytes;
+}
+
+
+} //namespace AMQP_QT
@@ -0,0 +1,112 @@
+#ifndef QMQDELIVERYBUFFER_H
+#define QMQDELIVERYBUFFER_H
+
+#include <QByteArray>
+#include <QQueue>
+#include <QVector>
+#include <QHash>
+#include "amqpcpp.h"
+
+
+namespace AMQP_QT {
+
+// 多队列消费时的本地调度策略
+enum MqSchedulePolicy {
+    MqScheduleWeighted = 0, // 按权重公平调度(平滑加权轮询)，低权重队列不会被饿死
+    MqScheduleStrict = 1    // 严格优先级，权重大的队列有消息时总是先分发
+};
+
+// 收到但尚未分发给应用的消息
+typedef struct _mqdelivery
+{
+    QByteArray body;
+    std::string exchange;
+    std::string routingKey;
+    AMQP::MetaData meta;
+    uint64_t deliveryTag = 0;
+    bool redelivered = false;
+    int queueIndex = 0;     // 来源队列在消费列表中的序号
+    QString conflationKey;  // 合并模式下的key，缓冲中只保留同key的最新消息
+    uint64_t dedupKey = 0;  // 去重指纹，ack时记入去重窗口
+    qint64 receivedMs = 0;  // 收到的时间(毫秒)，只在检查过期时记录
+    bool inlineRetry = false; // 内联处理reject后等待重试，重试时仍交给内联处理函数
+    bool placeholder = false; // 合并模式下代替消息排队的占位，出队时换成合并表中的最新消息
+} MqDelivery;
+
+
+/**
+ * @brief The QMqDeliveryBuffer class 消费端本地缓冲
+ * 按消息数和字节数统计，用高/低水位判断是否需要暂停或恢复投递；
+ * 水位为0表示不限制。已分发但未ack的消息也计入占用，保证手动ack模式下内存有界
+ */
+class QMqDeliveryBuffer
+{
+public:
+    QMqDeliveryBuffer() = default;
+
+    // 设置高低水位
+    void setWatermarks(qint64 highBytes, qint64 lowBytes, int highMessages, int lowMessages);
+    // 设置各来源队列的权重和调度策略，默认只有一个队列
+    void setQueueWeights(const QVector<int> &weights, MqSchedulePolicy policy);
+    // 按消息的priority属性分级，levels为级数(0~levels-1，超出的按最高级)，同级先进先出；
+    // 多队列时先按权重选出来源队列，再取该队列中优先级最高的消息。1表示不分级，在setQueueWeights之后调用
+    void setPriorityLevels(int levels);
+
+    void push(MqDelivery &&delivery);
+    // 合并模式入队：同一来源队列中同key的消息还未分发时原位替换并保留排队位置，返回true并给出被替换消息的deliveryTag；
+    // 新消息的优先级不同时移到新优先级的队尾。key为空的消息不参与合并，按push入队
+    bool pushConflated(MqDelivery &&delivery, uint64_t &supersededTag);
+    MqDelivery pop();
+    bool isEmpty() const;
+    // 清空缓冲，返回被丢弃的消息数(channel失效时，未ack的消息会由broker重新投递)
+    int clear();
+
+    // 已分发未ack的消息占用
+    void addUnacked(qint64 bytes);
+    void removeUnacked(qint64 bytes);
+
+    // 超过高水位
+    bool aboveHighWatermark() const;
+    // 低于低水位
+    bool belowLowWatermark() const;
+
+    int bufferedMessages() const;
+    qint64 bufferedBytes() const;
+    int unackedMessages() const;
+    qint64 unackedBytes() const;
+
+private:
+    // 选出下一个分发的来源队列
+    int SelectQueue();
+    // 消息所在的优先级
+    int PriorityLevel(const MqDelivery &delivery) const;
+    int QueueIndex(const MqDelivery &delivery) const;
+    // 合并表的key，不同来源队列的同名key互不替换
+    static QString ConflationSlot(const MqDelivery &delivery);
+    // 队列中代替合并消息排队的占位，只带key、来源队列和优先级
+    static MqDelivery Placeholder(const MqDelivery &delivery);
+
+private:
+    QVector<QVector<QQueue<MqDelivery>>> m_queues { QVector<QQueue<MqDelivery>>(1) };  // 来源队列 -> 各优先级
+    QVector<int> m_queueSizes { 0 };
+    int m_priorityLevels = 1;
+    QHash<QString, MqDelivery> m_conflated;   // 合并模式下排队中的消息(来源队列+key)，队列里只放占位
+    QVector<int> m_weights { 1 };
+    QVector<qint64> m_currentWeights { 0 };
+    MqSchedulePolicy m_policy = MqScheduleWeighted;
+    int m_bufferedMessages = 0;
+    qint64 m_bufferedBytes = 0;
+    qint64 m_unackedBytes = 0;
+    int m_unackedMessages = 0;
+
+    qint64 m_highBytes = 0;
+    qint64 m_lowBytes = 0;
+    int m_highMessages = 0;
+    int m_lowMessages = 0;
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQDELIVERYBUFFER_H
@@ -0,0 +1,210 @@
+#include "QMqDnsCache.h"
+#include <QCoreApplication>
+#include <QPointer>
+#include <QThread>
+
+
+namespace AMQP_QT {
+
+QMqDnsCache *QMqDnsCache::instance()
+{
+    // 实例带有运行中的定时器，不能留到线程局部变量析构时(可能晚于QCoreApplication)才释放
+    static thread_local QPointer<QMqDnsCache> cache;
+    if (!cache) {
+        cache = new QMqDnsCache();
+        QCoreApplication *app = QCoreApplication::instance();
+        QThread *thread = QThread::currentThread();
+        if (app && app->thread() == thread) {
+            cache->setParent(app);
+        }
+        else {
+            connect(thread, &QThread::finished, cache.data(), &QObject::deleteLater);
+        }
+    }
+    return cache.data();
+}
+
+QMqDnsCache::QMqDnsCache(QObject *parent)
+    : QObject(parent)
+{
+    m_clock.start();
+    connect(&m_refreshTimer, &QTimer::timeout, this, &QMqDnsCache::OnRefreshTimeout);
+    m_refreshTimer.start(1000);
+}
+
+bool QMqDnsCache::Resolve(const QString &host, QList<QHostAddress> &addresses, QString &err)
+{
+    addresses.clear();
+    QHostAddress literal;
+    if (literal.setAddress(host)) {
+        addresses.append(literal);
+        return true;
+    }
+
+    qint64 now = m_clock.elapsed();
+    if (m_entries.contains(host)) {
+        DnsEntry &entry = m_entries[host];
+        entry.lastUsedMs = now;
+        qint64 age = now - entry.resolvedMs;
+        if (entry.negative && age < m_negativeTtlMs) {
+            m_stats->negativeHits.add();
+            err = entry.errMessage;
+            return true;
+        }
+        if (!entry.negative) {
+            if (age < m_ttlMs) {
+                m_stats->cacheHits.add();
+            }
+            else {
+                // 过期后先用旧地址，后台刷新，避免重连时等待解析
+                m_stats->staleHits.add();
+                this->StartLookup(host);
+            }
+            addresses = entry.addresses;
+            return true;
+        }
+    }
+
+    // 第一次连接时没有可用地址，等待异步解析(预取已在进行时不再重复发起)
+    this->StartLookup(host);
+    return false;
+}
+
+void QMqDnsCache::Prefetch(const QString &host)
+{
+    QHostAddress literal;
+    if (literal.setAddress(host)) {
+        return;
+    }
+
+    qint64 now = m_clock.elapsed();
+    if (m_entries.contains(host)) {
+        DnsEntry &entry = m_entries[host];
+        entry.lastUsedMs = now;
+        if (now - entry.resolvedMs < (entry.negative ? m_negativeTtlMs : m_ttlMs)) {
+            return;
+        }
+    }
+    this->StartLookup(host);
+}
+
+bool QMqDnsCache::StartLookup(const QString &host)
+{
+    if (this->IsLookupPending(host)) {
+        return false;
+    }
+
+    PendingLookup pending;
+    pending.host = host;
+    pending.startMs = m_clock.elapsed();
+    int id = QHostInfo::lookupHost(host, this, SLOT(OnLookedUp(QHostInfo)));
+    m_pending.insert(id, pending);
+    m_stats->lookups.add();
+    return true;
+}
+
+bool QMqDnsCache::IsLookupPending(const QString &host) const
+{
+    for (const PendingLookup &pending : m_pending) {
+        if (pending.host == host) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void QMqDnsCache::OnLookedUp(const QHostInfo &info)
+{
+    if (!m_pending.contains(info.lookupId())) {
+        return;
+    }
+
+    PendingLookup pending = m_pending.take(info.lookupId());
+    this->StoreResult(pending.host, info, pending.startMs);
+    // 刷新失败时缓存中仍是旧地址，一并给出
+    const DnsEntry &entry = m_entries[pending.host];
+    emit sigLookupFinished(pending.host, entry.addresses, entry.negative ? entry.errMessage : QString());
+}
+
+void QMqDnsCache::StoreResult(const QString &host, const QHostInfo &info, qint64 startMs)
+{
+    qint64 now = m_clock.elapsed();
+    m_stats->latency.record((now - startMs) * 1000);
+
+    if (info.error() != QHostInfo::NoError || info.addresses().isEmpty()) {
+        m_stats->failures.add();
+        // 刷新失败时保留旧地址，下次使用时再刷新
+        if (m_entries.contains(host) && !m_entries[host].negative) {
+            return;
+        }
+        DnsEntry &entry = m_entries[host];
+        entry.addresses.clear();
+        entry.negative = true;
+        entry.errMessage = "Resolve Host Failed: " + host + ", " + info.errorString();
+        entry.resolvedMs = now;
+        return;
+    }
+
+    DnsEntry &entry = m_entries[host];
+    entry.addresses = info.addresses();
+    entry.negative = false;
+    entry.errMessage.clear();
+    entry.resolvedMs = now;
+}
+
+void QMqDnsCache::OnRefreshTimeout()
+{
+    qint64 now = m_clock.elapsed();
+    QList<QString> expired;
+    QList<QString> refresh;
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        const DnsEntry &entry = it.value();
+        // 长时间未使用的条目不再保留
+        if (now - entry.lastUsedMs > 10LL * m_ttlMs) {
+            expired.append(it.key());
+            continue;
+        }
+        // 近期用过的条目在过期前预取
+        if (!entry.negative && now - entry.resolvedMs > m_ttlMs * 4 / 5 && now - entry.lastUsedMs < m_ttlMs) {
+            refresh.append(it.key());
+        }
+    }
+
+    for (const QString &host : expired) {
+        m_entries.remove(host);
+    }
+    for (const QString &host : refresh) {
+        if (this->StartLookup(host)) {
+            m_stats->prefetches.add();
+        }
+    }
+}
+
+void QMqDnsCache::clear()
+{
+    for (auto it = m_pending.begin(); it != m_pending.end(); ++it) {
+        QHostInfo::abortHostLookup(it.key());
+    }
+    m_pending.clear();
+    m_entries.clear();
+}
+
+void QMqDnsCache::setTtl(int ttlMs, int negativeTtlMs)
+{
+    m_ttlMs = qMax(1000, ttlMs);
+    m_negativeTtlMs = qMax(0, negativeTtlMs);
+}
+
+MqDnsStats QMqDnsCache::getStats() const
+{
+    return *m_stats;
+}
+
+std::shared_ptr<const MqDnsStats> QMqDnsCache::getSharedStats() const
+{
+    return m_stats;
+}
+
+
+} //namespace AMQP_QT
@@ -0,0 +1,87 @@
+#ifndef QMQDNSCACHE_H
+#define QMQDNSCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include <QHostInfo>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <memory>
+#include "QMqStats.h"
+
+
+namespace AMQP_QT {
+
+
+/**
+ * @brief The QMqDnsCache class broker域名解析缓存
+ * 解析成功的地址缓存ttl时间，失败结果缓存negativeTtl时间；常用条目在过期前由QHostInfo异步预取，
+ * 过期未刷新完的条目先返回旧地址并在后台刷新，重连时不再等待解析；没有可用结果时只发起异步解析，
+ * 调用方在sigLookupFinished之后继续，不阻塞所在线程。
+ * QHostInfo不提供记录的TTL，ttl由配置给出。每个线程一个实例，随线程结束(主线程随QCoreApplication)释放
+ */
+class QMqDnsCache : public QObject
+{
+    Q_OBJECT
+public:
+    static QMqDnsCache *instance();
+
+    // 查询host的地址，IP直接返回。缓存中有结果时返回true，成功时写入addresses，失败时addresses为空、错误信息写入err；
+    // 没有可用结果时发起异步解析并返回false，结果由sigLookupFinished给出
+    bool Resolve(const QString &host, QList<QHostAddress> &addresses, QString &err);
+    // 异步解析，连接前调用可以提前完成解析
+    void Prefetch(const QString &host);
+    // 清空缓存
+    void clear();
+
+    void setTtl(int ttlMs, int negativeTtlMs);
+    MqDnsStats getStats() const;
+    // 统计对象本身，供其他线程读取
+    std::shared_ptr<const MqDnsStats> getSharedStats() const;
+
+signals:
+    // 一次异步解析结束，addresses为缓存中该host的地址，为空时err为失败原因
+    void sigLookupFinished(const QString &host, const QList<QHostAddress> &addresses, const QString &err);
+
+private slots:
+    void OnLookedUp(const QHostInfo &info);
+    // 对即将过期且近期用过的条目发起预取
+    void OnRefreshTimeout();
+
+private:
+    explicit QMqDnsCache(QObject *parent = nullptr);
+    // 发起异步解析，同一host已在解析中时返回false
+    bool StartLookup(const QString &host);
+    bool IsLookupPending(const QString &host) const;
+    void StoreResult(const QString &host, const QHostInfo &info, qint64 startMs);
+
+    struct DnsEntry {
+        QList<QHostAddress> addresses;
+        QString errMessage;
+        qint64 resolvedMs = 0;
+        qint64 lastUsedMs = 0;
+        bool negative = false;
+    };
+
+    struct PendingLookup {
+        QString host;
+        qint64 startMs;
+    };
+
+private:
+    QHash<QString, DnsEntry> m_entries;
+    QHash<int, PendingLookup> m_pending;     // lookupId -> 解析请求
+    QElapsedTimer m_clock;
+    QTimer m_refreshTimer;
+    int m_ttlMs = 60 * 1000;
+    int m_negativeTtlMs = 5 * 1000;
+    std::shared_ptr<MqDnsStats> m_stats = std::make_shared<MqDnsStats>();
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQDNSCACHE_H
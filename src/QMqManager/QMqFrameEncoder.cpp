@@ -0,0 +1,140 @@
+#include "QMqFrameEncoder.h"
+#include <QtGlobal>
+#include <stdexcept>
+#include "amqpcpp.h"
+
+
+namespace AMQP_QT {
+
+namespace {
+
+// 帧类型及basic类的编号，见AMQP 0-9-1规范
+const uint8_t FrameMethod = 1;
+const uint8_t FrameHeader = 2;
+const uint8_t FrameBody = 3;
+const uint8_t FrameEnd = 0xCE;
+const uint16_t ClassBasic = 60;
+const uint16_t MethodPublish = 40;
+
+/**
+ * @brief The ByteArrayOutBuffer class 把AMQP-CPP的编码结果直接写入QByteArray
+ */
+class ByteArrayOutBuffer : public AMQP::OutBuffer
+{
+public:
+    explicit ByteArrayOutBuffer(QByteArray &buffer) : m_buffer(buffer) {}
+
+protected:
+    virtual void append(const void *data, size_t size) override
+    {
+        m_buffer.append(static_cast<const char *>(data), (int)size);
+    }
+
+private:
+    QByteArray &m_buffer;
+};
+
+void AppendShortString(AMQP::OutBuffer &buffer, const std::string &value)
+{
+    if (value.size() > 255) {
+        throw std::runtime_error("short string too long: " + value.substr(0, 32));
+    }
+    buffer.add((uint8_t)value.size());
+    buffer.add(value);
+}
+
+} //namespace
+
+
+void QMqFrameEncoder::AppendFrameHeader(QByteArray &frame, uint8_t type, uint16_t channelId, uint32_t payloadSize)
+{
+    ByteArrayOutBuffer buffer(frame);
+    buffer.add(type);
+    buffer.add(channelId);
+    buffer.add(payloadSize);
+}
+
+QByteArray QMqFrameEncoder::EncodePublishMethod(uint16_t channelId, const std::string &exchange,
+                                                const std::string &routingKey, int flags)
+{
+    // class + method + reserved + exchange + routingKey + bits
+    uint32_t payloadSize = 2 + 2 + 2 + 1 + (uint32_t)exchange.size() + 1 + (uint32_t)routingKey.size() + 1;
+
+    QByteArray frame;
+    frame.reserve((int)(FrameOverhead + payloadSize));
+    AppendFrameHeader(frame, FrameMethod, channelId, payloadSize);
+
+    ByteArrayOutBuffer buffer(frame);
+    buffer.add(ClassBasic);
+    buffer.add(MethodPublish);
+    buffer.add((uint16_t)0);
+    AppendShortString(buffer, exchange);
+    AppendShortString(buffer, routingKey);
+
+    uint8_t bits = 0;
+    if (flags & AMQP::mandatory) bits |= 0x01;
+    if (flags & AMQP::immediate) bits |= 0x02;
+    buffer.add(bits);
+    buffer.add(FrameEnd);
+
+    return frame;
+}
+
+QByteArray QMqFrameEncoder::EncodeContentHeader(uint16_t channelId, const AMQP::MetaData &meta, uint64_t bodySize)
+{
+    // class + weight + bodySize + properties
+    uint32_t payloadSize = 2 + 2 + 8 + meta.size();
+
+    QByteArray frame;
+    frame.reserve((int)(FrameOverhead + payloadSize));
+    AppendFrameHeader(frame, FrameHeader, channelId, payloadSize);
+
+    ByteArrayOutBuffer buffer(frame);
+    buffer.add(ClassBasic);
+    buffer.add((uint16_t)0);
+    buffer.add(bodySize);
+    meta.fill(buffer);
+    buffer.add(FrameEnd);
+
+    return frame;
+}
+
+QByteArray QMqFrameEncoder::EncodeContentHeader(uint16_t channelId, const QByteArray &properties, uint64_t bodySize)
+{
+    uint32_t payloadSize = 2 + 2 + 8 + (uint32_t)properties.size();
+
+    QByteArray frame;
+    frame.reserve((int)(FrameOverhead + payloadSize));
+    AppendFrameHeader(frame, FrameHeader, channelId, payloadSize);
+
+    ByteArrayOutBuffer buffer(frame);
+    buffer.add(ClassBasic);
+    buffer.add((uint16_t)0);
+    buffer.add(bodySize);
+    frame.append(properties);
+    buffer.add(FrameEnd);
+
+    return frame;
+}
+
+QList<QByteArray> QMqFrameEncoder::EncodeBody(uint16_t channelId, const char *data, uint64_t size, uint32_t maxFrame)
+{
+    uint64_t maxPayload = maxFrame > FrameOverhead ? maxFrame - FrameOverhead : 4096 - FrameOverhead;
+
+    QList<QByteArray> frames;
+    for (uint64_t offset = 0; offset < size; offset += maxPayload) {
+        uint32_t chunk = (uint32_t)qMin<uint64_t>(maxPayload, size - offset);
+
+        QByteArray frame;
+        frame.reserve((int)(FrameOverhead + chunk));
+        AppendFrameHeader(frame, FrameBody, channelId, chunk);
+        frame.append(data + offset, (int)chunk);
+        frame.append((char)FrameEnd);
+        frames.append(frame);
+    }
+
+    return frames;
+}
+
+
+} //namespace AMQP_QT
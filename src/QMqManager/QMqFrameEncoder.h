@@ -0,0 +1,47 @@
+#ifndef QMQFRAMEENCODER_H
+#define QMQFRAMEENCODER_H
+
+#include <QByteArray>
+#include <QList>
+#include <string>
+
+
+namespace AMQP {
+class MetaData;
+}
+
+
+namespace AMQP_QT {
+
+
+/**
+ * @brief The QMqFrameEncoder class 直接编码basic.publish相关的AMQP帧
+ * 用于一份内容发往多个目标、或固定目标反复发送的场景：内容头帧和body帧只编码一次，
+ * 每个目标只需一个新的方法帧。编码结果与AMQP-CPP内部的编码一致
+ */
+class QMqFrameEncoder
+{
+public:
+    // 帧头: type(1) + channel(2) + payloadSize(4)，之后是payload和1字节帧结束符
+    static constexpr uint32_t FrameHeaderSize = 7;
+    static constexpr uint32_t FrameOverhead = FrameHeaderSize + 1;
+
+    // basic.publish方法帧
+    static QByteArray EncodePublishMethod(uint16_t channelId, const std::string &exchange,
+                                          const std::string &routingKey, int flags = 0);
+    // 内容头帧，属性编码由MetaData完成
+    static QByteArray EncodeContentHeader(uint16_t channelId, const AMQP::MetaData &meta, uint64_t bodySize);
+    // 内容头帧，properties为已编码的属性(如录制的消息)
+    static QByteArray EncodeContentHeader(uint16_t channelId, const QByteArray &properties, uint64_t bodySize);
+    // 按maxFrame切分的body帧
+    static QList<QByteArray> EncodeBody(uint16_t channelId, const char *data, uint64_t size, uint32_t maxFrame);
+
+private:
+    static void AppendFrameHeader(QByteArray &frame, uint8_t type, uint16_t channelId, uint32_t payloadSize);
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQFRAMEENCODER_H
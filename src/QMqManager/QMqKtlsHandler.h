@@ -0,0 +1,68 @@
+#ifndef QMQKTLSHANDLER_H
+#define QMQKTLSHANDLER_H
+
+#include <openssl/ssl.h>
+#include "amqpcpp.h"
+#include "amqpcpp/linux_tcp.h"
+
+
+namespace AMQP_QT {
+
+
+/**
+ * @brief The QMqKtlsHandler class 使用AMQP-CPP linux_tcp模块时的TcpHandler基类，握手后由内核加密TLS记录(kTLS)
+ * onSecuring中打开SSL_OP_ENABLE_KTLS，OpenSSL(3.0以上且编译时启用ktls)握手完成后把协商的密钥装入内核，
+ * 之后SSL_write直接走send，不再在用户态加密和拷贝。内核未加载tls模块或加密套件不支持时自动退回用户态加密，
+ * 实际结果在onSecured之后通过isKernelTlsSend/isKernelTlsRecv查看。
+ * 只用于linux_tcp模块(amqps://地址)，Qt封装不使用该模块；需要链接libssl
+ */
+class QMqKtlsHandler : public AMQP::TcpHandler
+{
+public:
+    explicit QMqKtlsHandler(bool enableKtls = true) : m_enableKtls(enableKtls) {}
+    virtual ~QMqKtlsHandler() = default;
+
+    // 子类重写时需先调用基类实现
+    virtual bool onSecuring(AMQP::TcpConnection *connection, SSL *ssl) override
+    {
+        (void) connection;
+#ifdef SSL_OP_ENABLE_KTLS
+        if (m_enableKtls) {
+            SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+        }
+#else
+        (void) ssl;
+#endif
+        return true;
+    }
+
+    virtual bool onSecured(AMQP::TcpConnection *connection, const SSL *ssl) override
+    {
+        (void) connection;
+        m_ktlsSend = false;
+        m_ktlsRecv = false;
+#ifdef SSL_OP_ENABLE_KTLS
+        m_ktlsSend = BIO_get_ktls_send(SSL_get_wbio(ssl)) > 0;
+        m_ktlsRecv = BIO_get_ktls_recv(SSL_get_rbio(ssl)) > 0;
+#else
+        (void) ssl;
+#endif
+        return true;
+    }
+
+    // 发送方向是否由内核加密
+    bool isKernelTlsSend() const { return m_ktlsSend; }
+    // 接收方向是否由内核解密
+    bool isKernelTlsRecv() const { return m_ktlsRecv; }
+
+private:
+    bool m_enableKtls = true;
+    bool m_ktlsSend = false;
+    bool m_ktlsRecv = false;
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQKTLSHANDLER_H
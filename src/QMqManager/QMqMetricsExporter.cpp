@@ -0,0 +1,392 @@
+#include "QMqMetricsExporter.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTcpSocket>
+#include <functional>
+
+
+namespace AMQP_QT {
+
+namespace {
+
+// 请求头的长度上限，超过时直接断开
+const int MaxRequestBytes = 8 * 1024;
+
+struct MetricsEntry
+{
+    QRabbitmqMgr *mgr;          // 只用于登记和移除，不解引用
+    QString name;
+    MqMetricsSources sources;
+};
+
+// 进程内唯一的指标表，各线程的实例登记到同一张表
+QMutex g_metricsMutex;
+QList<MetricsEntry> g_metricsEntries;
+
+// 一个实例在某一时刻的统计
+struct MetricsSnapshot
+{
+    QByteArray labels;
+    MqConnectionStats conn;
+    MqConsumerStats consumer;
+    MqTxStats tx;
+    MqArchiveStats archive;
+    MqTlsStats tls;
+    MqDnsStats dns;
+    MqLaneStats lanes[MqLaneCount];
+};
+
+typedef std::function<uint64_t(const MetricsSnapshot &)> CounterGetter;
+typedef std::function<const MqLatencyStats &(const MetricsSnapshot &)> LatencyGetter;
+
+QByteArray EscapeLabel(const QString &value)
+{
+    QByteArray escaped;
+    for (char c : value.toUtf8()) {
+        if (c == '\\' || c == '"') {
+            escaped.append('\\').append(c);
+        }
+        else if (c == '\n') {
+            escaped.append("\\n");
+        }
+        else {
+            escaped.append(c);
+        }
+    }
+    return escaped;
+}
+
+void AppendHeader(QByteArray &out, const char *name, const char *type, const char *help)
+{
+    out.append("# HELP ").append(name).append(' ').append(help).append('\n');
+    out.append("# TYPE ").append(name).append(' ').append(type).append('\n');
+}
+
+void AppendFamily(QByteArray &out, const QList<MetricsSnapshot> &snapshots, const char *name, const char *type,
+                  const char *help, const CounterGetter &getter)
+{
+    AppendHeader(out, name, type, help);
+    for (const MetricsSnapshot &snapshot : snapshots) {
+        out.append(name).append('{').append(snapshot.labels).append("} ")
+           .append(QByteArray::number((qulonglong)getter(snapshot))).append('\n');
+    }
+}
+
+// 每个lane一行，带lane标签
+void AppendLaneFamily(QByteArray &out, const QList<MetricsSnapshot> &snapshots, const char *name, const char *type,
+                      const char *help, const std::function<uint64_t(const MqLaneStats &)> &getter)
+{
+    static const char *laneNames[MqLaneCount] = { "control", "bulk" };
+
+    AppendHeader(out, name, type, help);
+    for (const MetricsSnapshot &snapshot : snapshots) {
+        for (int lane = 0; lane < MqLaneCount; lane++) {
+            out.append(name).append('{').append(snapshot.labels).append(",lane=\"").append(laneNames[lane]).append("\"} ")
+               .append(QByteArray::number((qulonglong)getter(snapshot.lanes[lane]))).append('\n');
+        }
+    }
+}
+
+// 延迟按summary导出，单位转换为秒
+void AppendSummary(QByteArray &out, const QList<MetricsSnapshot> &snapshots, const char *name, const char *help,
+                   const LatencyGetter &getter)
+{
+    static const double quantiles[] = { 0.5, 0.9, 0.99 };
+
+    AppendHeader(out, name, "summary", help);
+    for (const MetricsSnapshot &snapshot : snapshots) {
+        const MqLatencyStats &latency = getter(snapshot);
+        for (double quantile : quantiles) {
+            out.append(name).append('{').append(snapshot.labels).append(",quantile=\"")
+               .append(QByteArray::number(quantile)).append("\"} ")
+               .append(QByteArray::number(latency.percentile(quantile) / 1e6)).append('\n');
+        }
+        out.append(name).append("_sum{").append(snapshot.labels).append("} ")
+           .append(QByteArray::number(latency.sumUs.load() / 1e6)).append('\n');
+        out.append(name).append("_count{").append(snapshot.labels).append("} ")
+           .append(QByteArray::number((qulonglong)latency.count.load())).append('\n');
+    }
+}
+
+} //namespace
+
+
+QMqMetricsExporter::QMqMetricsExporter(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QMqMetricsExporter::~QMqMetricsExporter()
+{
+    this->Close();
+}
+
+bool QMqMetricsExporter::Listen(const QHostAddress &address, quint16 port)
+{
+    this->Close();
+
+    m_pServer = std::make_shared<QTcpServer>();
+    if (!m_pServer->listen(address, port)) {
+        m_errMessage = "Metrics Listen Failed: " + m_pServer->errorString();
+        m_pServer = nullptr;
+        return false;
+    }
+
+    connect(m_pServer.get(), &QTcpServer::newConnection, this, &QMqMetricsExporter::OnNewConnection);
+    return true;
+}
+
+void QMqMetricsExporter::Close()
+{
+    if (m_pServer) {
+        m_pServer->close();
+        m_pServer = nullptr;
+    }
+}
+
+quint16 QMqMetricsExporter::serverPort() const
+{
+    return m_pServer ? m_pServer->serverPort() : 0;
+}
+
+QString QMqMetricsExporter::getErrorMessage() const
+{
+    return m_errMessage;
+}
+
+bool QMqMetricsExporter::Register(QRabbitmqMgr *mgr, const QString &name, const MqMetricsSources &sources, QString &err)
+{
+    QMutexLocker locker(&g_metricsMutex);
+    // 同名实例会输出重复的时间序列
+    for (const MetricsEntry &entry : g_metricsEntries) {
+        if (entry.mgr != mgr && entry.name == name) {
+            err = "Register Metrics Failed: duplicate metricsName " + name;
+            return false;
+        }
+    }
+    for (MetricsEntry &entry : g_metricsEntries) {
+        if (entry.mgr == mgr) {
+            entry.name = name;
+            entry.sources = sources;
+            return true;
+        }
+    }
+
+    MetricsEntry entry;
+    entry.mgr = mgr;
+    entry.name = name;
+    entry.sources = sources;
+    g_metricsEntries.append(entry);
+    return true;
+}
+
+void QMqMetricsExporter::Update(QRabbitmqMgr *mgr, const MqMetricsSources &sources)
+{
+    QMutexLocker locker(&g_metricsMutex);
+    for (MetricsEntry &entry : g_metricsEntries) {
+        if (entry.mgr == mgr) {
+            entry.sources = sources;
+        }
+    }
+}
+
+void QMqMetricsExporter::Unregister(QRabbitmqMgr *mgr)
+{
+    QMutexLocker locker(&g_metricsMutex);
+    for (int i = g_metricsEntries.size() - 1; i >= 0; i--) {
+        if (g_metricsEntries[i].mgr == mgr) {
+            g_metricsEntries.removeAt(i);
+        }
+    }
+}
+
+QByteArray QMqMetricsExporter::Scrape()
+{
+    // 加锁只复制条目，统计对象由shared_ptr保持，读取时实例可以同时销毁
+    QList<MetricsEntry> entries;
+    {
+        QMutexLocker locker(&g_metricsMutex);
+        entries = g_metricsEntries;
+    }
+
+    // 先取全部快照，再按指标分组输出，同一指标的各实例连续排列
+    QList<MetricsSnapshot> snapshots;
+    for (const MetricsEntry &entry : entries) {
+        const MqMetricsSources &sources = entry.sources;
+        MetricsSnapshot snapshot;
+        snapshot.labels = "instance=\"" + EscapeLabel(entry.name) + "\"";
+        snapshot.conn = *sources.conn;
+        snapshot.consumer = *sources.consumer;
+        snapshot.tx = *sources.tx;
+        if (sources.archive) {
+            snapshot.archive = *sources.archive;
+        }
+        snapshot.archive.replayed = *sources.replayed;
+        if (sources.socket) {
+            snapshot.tls = sources.socket->tls;
+            for (int lane = 0; lane < MqLaneCount; lane++) {
+                snapshot.lanes[lane] = sources.socket->lanes[lane];
+            }
+        }
+        if (sources.dns) {
+            snapshot.dns = *sources.dns;
+        }
+        snapshots.append(snapshot);
+    }
+
+    QByteArray out;
+    out.reserve(16 * 1024);
+
+    AppendFamily(out, snapshots, "qamqp_connects_total", "counter", "Connections established (more than one means reconnects).",
+                 [](const MetricsSnapshot &s) { return s.conn.connects.load(); });
+    AppendFamily(out, snapshots, "qamqp_connect_errors_total", "counter", "Connection or channel errors that closed the instance.",
+                 [](const MetricsSnapshot &s) { return s.conn.connectErrors.load(); });
+    AppendFamily(out, snapshots, "qamqp_channel_recoveries_total", "counter", "Channels rebuilt on the same connection.",
+                 [](const MetricsSnapshot &s) { return s.consumer.channelRecoveries.load(); });
+
+    AppendLaneFamily(out, snapshots, "qamqp_lane_frames_total", "counter", "Frames written to the socket.",
+                     [](const MqLaneStats &l) { return l.frames.load(); });
+    AppendLaneFamily(out, snapshots, "qamqp_lane_bytes_total", "counter", "Bytes written to the socket.",
+                     [](const MqLaneStats &l) { return l.bytes.load(); });
+    AppendLaneFamily(out, snapshots, "qamqp_lane_queued_frames", "gauge", "Frames waiting in the lane queue.",
+                     [](const MqLaneStats &l) { return l.queuedFrames.load(); });
+    AppendLaneFamily(out, snapshots, "qamqp_lane_queued_bytes", "gauge", "Bytes waiting in the lane queue.",
+                     [](const MqLaneStats &l) { return l.queuedBytes.load(); });
+    AppendLaneFamily(out, snapshots, "qamqp_lane_conflated_total", "counter", "Queued messages replaced by a newer one.",
+                     [](const MqLaneStats &l) { return l.conflated.load(); });
+    AppendSummary(out, snapshots, "qamqp_lane_control_wait_seconds", "Control lane time from enqueue to socket write.",
+                  [](const MetricsSnapshot &s) -> const MqLatencyStats & { return s.lanes[MqLaneControl].latency; });
+    AppendSummary(out, snapshots, "qamqp_lane_bulk_wait_seconds", "Bulk lane time from enqueue to socket write.",
+                  [](const MetricsSnapshot &s) -> const MqLatencyStats & { return s.lanes[MqLaneBulk].latency; });
+
+    AppendFamily(out, snapshots, "qamqp_consumer_received_total", "counter", "Messages received.",
+                 [](const MetricsSnapshot &s) { return s.consumer.received.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_dispatched_total", "counter", "Messages dispatched to the application.",
+                 [](const MetricsSnapshot &s) { return s.consumer.dispatched.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_acked_total", "counter", "Messages acked.",
+                 [](const MetricsSnapshot &s) { return s.consumer.acked.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_rejected_total", "counter", "Messages rejected.",
+                 [](const MetricsSnapshot &s) { return s.consumer.rejected.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_buffered_messages", "gauge", "Messages in the local delivery buffer.",
+                 [](const MetricsSnapshot &s) { return s.consumer.bufferedMessages.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_buffered_bytes", "gauge", "Bytes in the local delivery buffer.",
+                 [](const MetricsSnapshot &s) { return s.consumer.bufferedBytes.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_unacked_messages", "gauge", "Dispatched messages not yet acked.",
+                 [](const MetricsSnapshot &s) { return s.consumer.unackedMessages.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_unacked_bytes", "gauge", "Bytes of dispatched messages not yet acked.",
+                 [](const MetricsSnapshot &s) { return s.consumer.unackedBytes.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_pauses_total", "counter", "Delivery pauses caused by the high watermark.",
+                 [](const MetricsSnapshot &s) { return s.consumer.pauseCount.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_paused_ms_total", "counter", "Milliseconds delivery was paused by flow control.",
+                 [](const MetricsSnapshot &s) { return s.consumer.pausedMs.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_retried_total", "counter", "Local delayed retries.",
+                 [](const MetricsSnapshot &s) { return s.consumer.retried.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_retry_held", "gauge", "Messages waiting for a retry.",
+                 [](const MetricsSnapshot &s) { return s.consumer.retryHeld.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_dead_lettered_total", "counter", "Messages moved to the dead letter exchange.",
+                 [](const MetricsSnapshot &s) { return s.consumer.deadLettered.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_conflated_total", "counter", "Buffered messages replaced by a newer one.",
+                 [](const MetricsSnapshot &s) { return s.consumer.conflated.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_filter_dropped_total", "counter", "Messages dropped by the consume filter.",
+                 [](const MetricsSnapshot &s) { return s.consumer.filterDropped.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_dedup_dropped_total", "counter", "Redeliveries dropped by the dedup window.",
+                 [](const MetricsSnapshot &s) { return s.consumer.dedupDropped.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_inline_handled_total", "counter", "Messages handled by the inline handler.",
+                 [](const MetricsSnapshot &s) { return s.consumer.inlineHandled.load(); });
+    AppendFamily(out, snapshots, "qamqp_consumer_expired_total", "counter", "Messages skipped because their deadline passed.",
+                 [](const MetricsSnapshot &s) { return s.consumer.expired.load(); });
+
+    AppendFamily(out, snapshots, "qamqp_tx_committed_messages_total", "counter", "Messages in committed transactions.",
+                 [](const MetricsSnapshot &s) { return s.tx.committedMessages.load(); });
+    AppendFamily(out, snapshots, "qamqp_tx_failed_messages_total", "counter", "Messages in failed transactions.",
+                 [](const MetricsSnapshot &s) { return s.tx.failedMessages.load(); });
+    AppendFamily(out, snapshots, "qamqp_tx_inflight_commits", "gauge", "Commits sent and not yet answered.",
+                 [](const MetricsSnapshot &s) { return s.tx.inFlightCommits.load(); });
+    AppendSummary(out, snapshots, "qamqp_tx_commit_seconds", "Time from tx.commit to commit-ok.",
+                  [](const MetricsSnapshot &s) -> const MqLatencyStats & { return s.tx.commitLatency; });
+
+    AppendFamily(out, snapshots, "qamqp_archive_records_total", "counter", "Messages recorded to the archive.",
+                 [](const MetricsSnapshot &s) { return s.archive.records.load(); });
+    AppendFamily(out, snapshots, "qamqp_archive_replayed_total", "counter", "Archived messages replayed.",
+                 [](const MetricsSnapshot &s) { return s.archive.replayed.load(); });
+
+    AppendFamily(out, snapshots, "qamqp_tls_full_handshakes_total", "counter", "Full TLS handshakes.",
+                 [](const MetricsSnapshot &s) { return s.tls.fullHandshakes.load(); });
+    AppendFamily(out, snapshots, "qamqp_tls_resume_attempts_total", "counter", "TLS handshakes offering a cached session ticket.",
+                 [](const MetricsSnapshot &s) { return s.tls.resumeAttempts.load(); });
+    AppendFamily(out, snapshots, "qamqp_tls_failures_total", "counter", "Failed TLS handshakes.",
+                 [](const MetricsSnapshot &s) { return s.tls.failures.load(); });
+    AppendSummary(out, snapshots, "qamqp_tls_full_handshake_seconds", "Full TLS handshake time.",
+                  [](const MetricsSnapshot &s) -> const MqLatencyStats & { return s.tls.fullLatency; });
+    AppendSummary(out, snapshots, "qamqp_tls_resumed_handshake_seconds", "Resumed TLS handshake time.",
+                  [](const MetricsSnapshot &s) -> const MqLatencyStats & { return s.tls.resumedLatency; });
+    AppendSummary(out, snapshots, "qamqp_tls_full_handshake_cpu_seconds", "Process CPU time during full TLS handshakes.",
+                  [](const MetricsSnapshot &s) -> const MqLatencyStats & { return s.tls.fullCpu; });
+    AppendSummary(out, snapshots, "qamqp_tls_resumed_handshake_cpu_seconds", "Process CPU time during resumed TLS handshakes.",
+                  [](const MetricsSnapshot &s) -> const MqLatencyStats & { return s.tls.resumedCpu; });
+
+    AppendFamily(out, snapshots, "qamqp_dns_lookups_total", "counter", "Host lookups started, including prefetches.",
+                 [](const MetricsSnapshot &s) { return s.dns.lookups.load(); });
+    AppendFamily(out, snapshots, "qamqp_dns_cache_hits_total", "counter", "Resolves answered from the cache.",
+                 [](const MetricsSnapshot &s) { return s.dns.cacheHits.load(); });
+    AppendFamily(out, snapshots, "qamqp_dns_negative_hits_total", "counter", "Resolves answered from a cached failure.",
+                 [](const MetricsSnapshot &s) { return s.dns.negativeHits.load(); });
+    AppendFamily(out, snapshots, "qamqp_dns_stale_hits_total", "counter", "Expired entries used while refreshing in the background.",
+                 [](const MetricsSnapshot &s) { return s.dns.staleHits.load(); });
+    AppendFamily(out, snapshots, "qamqp_dns_failures_total", "counter", "Failed host lookups.",
+                 [](const MetricsSnapshot &s) { return s.dns.failures.load(); });
+    AppendFamily(out, snapshots, "qamqp_dns_prefetches_total", "counter", "Lookups started before an entry expired.",
+                 [](const MetricsSnapshot &s) { return s.dns.prefetches.load(); });
+    AppendSummary(out, snapshots, "qamqp_dns_lookup_seconds", "Host lookup time.",
+                  [](const MetricsSnapshot &s) -> const MqLatencyStats & { return s.dns.latency; });
+
+    return out;
+}
+
+void QMqMetricsExporter::OnNewConnection()
+{
+    while (m_pServer && m_pServer->hasPendingConnections()) {
+        QTcpSocket *socket = m_pServer->nextPendingConnection();
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            this->OnRequest(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_requests.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void QMqMetricsExporter::OnRequest(QTcpSocket *socket)
+{
+    // 请求很小，读到请求头结束再处理，之后一律关闭连接
+    QByteArray &request = m_requests[socket];
+    request.append(socket->readAll());
+    if (!request.contains("\r\n\r\n")) {
+        if (request.size() > MaxRequestBytes) {
+            m_requests.remove(socket);
+            socket->abort();
+        }
+        return;
+    }
+
+    QByteArray status = "200 OK";
+    QByteArray body;
+    if (request.startsWith("GET /metrics ") || request.startsWith("GET / ")) {
+        body = Scrape();
+    }
+    else {
+        status = "404 Not Found";
+    }
+    m_requests.remove(socket);
+
+    QByteArray response = "HTTP/1.0 " + status + "\r\n"
+                          "Content-Type: text/plain; version=0.0.4\r\n"
+                          "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                          "Connection: close\r\n\r\n";
+    socket->write(response + body);
+    socket->disconnectFromHost();
+}
+
+
+} //namespace AMQP_QT
@@ -0,0 +1,74 @@
+#ifndef QMQMETRICSEXPORTER_H
+#define QMQMETRICSEXPORTER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <memory>
+#include "QMqStats.h"
+#include "QTcpClient.h"
+
+
+namespace AMQP_QT {
+
+class QRabbitmqMgr;
+
+// 实例登记到指标表的统计对象，由实例和指标表共同持有，实例销毁后读取仍然安全
+typedef struct _mqmetricssources
+{
+    std::shared_ptr<const MqConnectionStats> conn;
+    std::shared_ptr<const MqConsumerStats> consumer;
+    std::shared_ptr<const MqTxStats> tx;
+    std::shared_ptr<const MqCounter> replayed;
+    std::shared_ptr<const MqArchiveStats> archive;  // 未启用录制时为空
+    std::shared_ptr<const MqSocketStats> socket;    // 未连接时为空，重连后更换
+    std::shared_ptr<const MqDnsStats> dns;          // 所在线程的解析缓存，同一线程的实例相同
+} MqMetricsSources;
+
+
+/**
+ * @brief The QMqMetricsExporter class 以Prometheus文本格式导出客户端内部统计
+ * MqInfo.metricsName非空的实例在构造时登记到进程内唯一的指标表，析构时移除，名称重复时登记失败。
+ * exporter监听本地端口，收到GET /metrics时读取所有线程登记的实例的统计快照；
+ * 指标表只在登记和复制条目时加锁，统计均为relaxed原子计数，读取时不加锁
+ */
+class QMqMetricsExporter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QMqMetricsExporter(QObject *parent = nullptr);
+    ~QMqMetricsExporter();
+
+    // 开始监听，port为0时由系统分配
+    bool Listen(const QHostAddress &address = QHostAddress::LocalHost, quint16 port = 0);
+    void Close();
+    quint16 serverPort() const;
+    QString getErrorMessage() const;
+
+    // 登记实例，name作为instance标签，与其他实例重名时返回false
+    static bool Register(QRabbitmqMgr *mgr, const QString &name, const MqMetricsSources &sources, QString &err);
+    // 更换已登记实例的统计对象(如重连后的连接统计)
+    static void Update(QRabbitmqMgr *mgr, const MqMetricsSources &sources);
+    static void Unregister(QRabbitmqMgr *mgr);
+    // 所有登记实例的统计，文本格式
+    static QByteArray Scrape();
+
+private slots:
+    void OnNewConnection();
+
+private:
+    void OnRequest(QTcpSocket *socket);
+
+private:
+    std::shared_ptr<QTcpServer> m_pServer = nullptr;
+    QHash<QTcpSocket *, QByteArray> m_requests;    // 各连接尚未读完的请求头
+    QString m_errMessage;
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQMETRICSEXPORTER_H
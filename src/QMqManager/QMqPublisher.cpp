@@ -0,0 +1,105 @@
+#include "QMqPublisher.h"
+#include "QRabbitmqMgr.h"
+#include "QMqFrameEncoder.h"
+
+
+namespace AMQP_QT {
+
+namespace {
+
+// 内容头帧中body长度的偏移：帧头之后是classId和weight
+const int HeaderBodySizeOffset = QMqFrameEncoder::FrameHeaderSize + 4;
+
+void WriteBigEndian(QByteArray &frame, int offset, uint64_t value, int bytes)
+{
+    char *data = frame.data();
+    for (int i = bytes - 1; i >= 0; i--) {
+        data[offset + i] = (char)(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+} //namespace
+
+
+QMqPublisher::QMqPublisher(QRabbitmqMgr *mgr, const std::string &exchange, const std::string &routingKey,
+                           int flags, const AMQP::MetaData &defaults, MqLane lane)
+    : m_mgr(mgr)
+    , m_exchange(exchange)
+    , m_routingKey(routingKey)
+    , m_flags(flags)
+    , m_defaults(defaults)
+    , m_lane(lane)
+{
+    // 超长的exchange或routingKey在这里就抛出异常，不会等到发送时
+    m_methodFrame = QMqFrameEncoder::EncodePublishMethod(m_channelId, m_exchange, m_routingKey, m_flags);
+    m_headerFrame = QMqFrameEncoder::EncodeContentHeader(m_channelId, m_defaults, 0);
+}
+
+bool QMqPublisher::Publish(const QByteArray &body)
+{
+    if (m_mgr.isNull()) {
+        return false;
+    }
+    return m_mgr->PublishBound(*this, body, nullptr);
+}
+
+bool QMqPublisher::Publish(const QByteArray &body, const AMQP::MetaData &overrides)
+{
+    if (m_mgr.isNull()) {
+        return false;
+    }
+    return m_mgr->PublishBound(*this, body, &overrides);
+}
+
+const std::string &QMqPublisher::exchange() const
+{
+    return m_exchange;
+}
+
+const std::string &QMqPublisher::routingKey() const
+{
+    return m_routingKey;
+}
+
+int QMqPublisher::flags() const
+{
+    return m_flags;
+}
+
+MqLane QMqPublisher::lane() const
+{
+    return m_lane;
+}
+
+const AMQP::MetaData &QMqPublisher::defaults() const
+{
+    return m_defaults;
+}
+
+const QByteArray &QMqPublisher::MethodFrame(uint16_t channelId)
+{
+    this->SetChannelId(channelId);
+    return m_methodFrame;
+}
+
+QByteArray QMqPublisher::HeaderFrame(uint16_t channelId, uint64_t bodySize)
+{
+    this->SetChannelId(channelId);
+    QByteArray frame = m_headerFrame;
+    WriteBigEndian(frame, HeaderBodySizeOffset, bodySize, 8);
+    return frame;
+}
+
+void QMqPublisher::SetChannelId(uint16_t channelId)
+{
+    if (channelId == m_channelId) {
+        return;
+    }
+    WriteBigEndian(m_methodFrame, 1, channelId, 2);
+    WriteBigEndian(m_headerFrame, 1, channelId, 2);
+    m_channelId = channelId;
+}
+
+
+} //namespace AMQP_QT
@@ -0,0 +1,63 @@
+#ifndef QMQPUBLISHER_H
+#define QMQPUBLISHER_H
+
+#include <QByteArray>
+#include <QPointer>
+#include <string>
+#include "amqpcpp.h"
+#include "QTcpClient.h"
+
+
+namespace AMQP_QT {
+
+class QRabbitmqMgr;
+
+
+/**
+ * @brief The QMqPublisher class 绑定了exchange、routingKey和默认属性的发布句柄
+ * 由QRabbitmqMgr::CreatePublisher创建。方法帧和默认属性的内容头帧在创建时编码一次，
+ * 每条消息只需填入body长度并编码body帧；channel重建后只改写帧中的channel号。
+ * 与QRabbitmqMgr在同一线程中使用，QRabbitmqMgr销毁后发布直接返回失败
+ */
+class QMqPublisher
+{
+public:
+    QMqPublisher(QRabbitmqMgr *mgr, const std::string &exchange, const std::string &routingKey,
+                 int flags, const AMQP::MetaData &defaults, MqLane lane);
+
+    // 以默认属性发布
+    bool Publish(const QByteArray &body);
+    // 以overrides替代默认属性发布，该消息的内容头帧单独编码
+    bool Publish(const QByteArray &body, const AMQP::MetaData &overrides);
+
+    const std::string &exchange() const;
+    const std::string &routingKey() const;
+    int flags() const;
+    MqLane lane() const;
+    const AMQP::MetaData &defaults() const;
+
+    // 指定channel上的方法帧和默认属性的内容头帧
+    const QByteArray &MethodFrame(uint16_t channelId);
+    QByteArray HeaderFrame(uint16_t channelId, uint64_t bodySize);
+
+private:
+    void SetChannelId(uint16_t channelId);
+
+private:
+    QPointer<QRabbitmqMgr> m_mgr;
+    std::string m_exchange;
+    std::string m_routingKey;
+    int m_flags = 0;
+    AMQP::MetaData m_defaults;
+    MqLane m_lane = MqLaneControl;
+
+    uint16_t m_channelId = 0;   // 缓存的帧当前所属的channel
+    QByteArray m_methodFrame;
+    QByteArray m_headerFrame;   // body长度为0的内容头帧，发送时改写长度
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQPUBLISHER_H
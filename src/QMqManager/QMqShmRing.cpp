@@ -0,0 +1,443 @@
+#include "QMqShmRing.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+
+namespace AMQP_QT {
+
+namespace {
+
+const uint32_t ShmRingMagic = 0x514D5152;   // "QMQR"
+const uint32_t ShmRingVersion = 2;
+
+/**
+ * @brief The MqShmRecord struct 每条消息前的记录头，记录可以跨越数据区末尾
+ */
+struct MqShmRecord
+{
+    uint32_t recordLen;     // 记录头 + exchange + routingKey + body
+    uint32_t bodyLen;
+    uint16_t exchangeLen;
+    uint16_t routingKeyLen;
+    uint32_t reserved;
+};
+
+qint64 NowMs()
+{
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+} //namespace
+
+
+struct MqShmReaderSlot
+{
+    std::atomic<uint64_t> cursor;
+    std::atomic<qint64> heartbeatMs;
+    std::atomic<uint32_t> active;
+    uint32_t reserved;
+};
+
+struct MqShmRingHeader
+{
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint64_t capacity;
+    std::atomic<qint64> writerPid;          // 当前写端的进程号，0表示没有写端
+    std::atomic<qint64> writerHeartbeatMs;  // 写端心跳，超时后才允许其他进程接管
+    std::atomic<uint64_t> reserve;  // 写端正在写入的结束位置
+    std::atomic<uint64_t> commit;   // 已写完的结束位置
+    MqShmReaderSlot readers[QMqShmRing::MaxReaders];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory ring requires lock-free 64-bit atomics");
+
+// 数据区按cache line对齐
+static const qint64 ShmDataOffset = (sizeof(MqShmRingHeader) + 63) / 64 * 64;
+
+
+QMqShmRing::QMqShmRing(QObject *parent)
+    : QObject(parent)
+{
+    connect(&m_pollTimer, &QTimer::timeout, this, &QMqShmRing::OnPollTimeout);
+    connect(&m_heartbeatTimer, &QTimer::timeout, this, &QMqShmRing::OnHeartbeatTimeout);
+}
+
+QMqShmRing::~QMqShmRing()
+{
+    this->Detach();
+}
+
+bool QMqShmRing::CreateWriter(const QString &key, qint64 capacity, MqShmOverrunPolicy policy)
+{
+    this->Detach();
+    capacity = qMax<qint64>(capacity, 64 * 1024);
+    m_shm.setKey(key);
+
+    auto initHeader = [this, capacity]() {
+        MqShmRingHeader *header = new (m_shm.data()) MqShmRingHeader();
+        header->version = ShmRingVersion;
+        header->capacity = (uint64_t)capacity;
+        header->writerPid.store(0);
+        header->writerHeartbeatMs.store(0);
+        header->reserve.store(0);
+        header->commit.store(0);
+        for (int i = 0; i < MaxReaders; i++) {
+            header->readers[i].cursor.store(0);
+            header->readers[i].heartbeatMs.store(0);
+            header->readers[i].active.store(0);
+        }
+        header->magic.store(ShmRingMagic, std::memory_order_release);
+    };
+
+    // 检查和登记写端在共享内存锁内完成，两个进程同时启动时只有一个成为写端
+    if (m_shm.create(ShmDataOffset + capacity)) {
+        m_shm.lock();
+        initHeader();
+    }
+    else if (m_shm.error() == QSharedMemory::AlreadyExists && m_shm.attach()) {
+        m_shm.lock();
+        // 上一个写端退出后共享内存仍在(读端未退出或进程崩溃)，接管并沿用原有位置，读端不受影响
+        if (!this->MapHeader() || m_capacity != (uint64_t)capacity) {
+            // 没有其他进程连接时detach会释放旧的共享内存，可以按新容量重建
+            m_shm.unlock();
+            m_shm.detach();
+            if (!m_shm.create(ShmDataOffset + capacity)) {
+                m_errMessag = "Create Shm Ring Failed: existing segment is incompatible, " + m_shm.errorString();
+                return false;
+            }
+            m_shm.lock();
+            initHeader();
+        }
+        else if (this->IsWriterAlive()) {
+            m_errMessag = "Create Shm Ring Failed: writer process " + QString::number(m_header->writerPid.load())
+                    + " is still alive";
+            m_header = nullptr;
+            m_shm.unlock();
+            this->Detach();
+            return false;
+        }
+    }
+    else {
+        m_errMessag = "Create Shm Ring Failed: " + m_shm.errorString();
+        return false;
+    }
+
+    if (!this->MapHeader()) {
+        m_shm.unlock();
+        this->Detach();
+        return false;
+    }
+    m_pid = QCoreApplication::applicationPid();
+    m_header->writerPid.store(m_pid);
+    m_header->writerHeartbeatMs.store(NowMs());
+    // 上一个写端可能在写入中途退出，未提交的部分作废
+    m_header->reserve.store(m_header->commit.load());
+    m_shm.unlock();
+
+    m_writer = true;
+    m_policy = policy;
+    m_heartbeatTimer.start(qMax(100, m_readerTimeoutMs / 4));
+    return true;
+}
+
+bool QMqShmRing::IsWriterAlive() const
+{
+    return m_header->writerPid.load() != 0 && NowMs() - m_header->writerHeartbeatMs.load() <= m_readerTimeoutMs;
+}
+
+void QMqShmRing::OnHeartbeatTimeout()
+{
+    if (!m_writer || m_header == nullptr) {
+        return;
+    }
+    // 心跳中断过久(如进程被挂起)时已被其他进程接管，不再写入
+    if (m_header->writerPid.load() != m_pid) {
+        m_errMessag = "Shm Ring: writer taken over by process " + QString::number(m_header->writerPid.load());
+        m_writer = false;
+        m_heartbeatTimer.stop();
+        return;
+    }
+    m_header->writerHeartbeatMs.store(NowMs());
+}
+
+bool QMqShmRing::AttachReader(const QString &key, int pollMs)
+{
+    this->Detach();
+    m_shm.setKey(key);
+    if (!m_shm.attach()) {
+        m_errMessag = "Attach Shm Ring Failed: " + m_shm.errorString();
+        return false;
+    }
+    if (!this->MapHeader()) {
+        this->Detach();
+        return false;
+    }
+
+    // 占用空闲槽位，没有时回收心跳超时的槽位
+    qint64 now = NowMs();
+    for (int i = 0; i < MaxReaders && m_readerSlot < 0; i++) {
+        uint32_t expected = 0;
+        if (m_header->readers[i].active.compare_exchange_strong(expected, 1)) {
+            m_readerSlot = i;
+        }
+    }
+    for (int i = 0; i < MaxReaders && m_readerSlot < 0; i++) {
+        qint64 heartbeat = m_header->readers[i].heartbeatMs.load();
+        if (now - heartbeat > m_readerTimeoutMs
+                && m_header->readers[i].heartbeatMs.compare_exchange_strong(heartbeat, now)) {
+            m_readerSlot = i;
+        }
+    }
+    if (m_readerSlot < 0) {
+        m_errMessag = "Attach Shm Ring Failed: no free reader slot";
+        this->Detach();
+        return false;
+    }
+
+    MqShmReaderSlot &slot = m_header->readers[m_readerSlot];
+    m_cursor = m_header->commit.load(std::memory_order_acquire);
+    slot.cursor.store(m_cursor, std::memory_order_release);
+    slot.heartbeatMs.store(now);
+    slot.active.store(1, std::memory_order_release);
+
+    m_pollTimer.start(qMax(1, pollMs));
+    return true;
+}
+
+void QMqShmRing::Detach()
+{
+    m_pollTimer.stop();
+    m_heartbeatTimer.stop();
+    if (m_header && m_readerSlot >= 0) {
+        m_header->readers[m_readerSlot].active.store(0, std::memory_order_release);
+    }
+    // 正常退出时立即让出写端，新的写端不必等心跳超时
+    if (m_header && m_writer) {
+        qint64 pid = m_pid;
+        m_header->writerPid.compare_exchange_strong(pid, 0);
+    }
+    if (m_shm.isAttached()) {
+        m_shm.detach();
+    }
+    m_header = nullptr;
+    m_data = nullptr;
+    m_capacity = 0;
+    m_writer = false;
+    m_readerSlot = -1;
+    m_cursor = 0;
+}
+
+bool QMqShmRing::MapHeader()
+{
+    if (m_shm.size() < ShmDataOffset) {
+        m_errMessag = "Shm Ring: segment too small";
+        return false;
+    }
+
+    MqShmRingHeader *header = static_cast<MqShmRingHeader *>(m_shm.data());
+    if (header->magic.load(std::memory_order_acquire) != ShmRingMagic || header->version != ShmRingVersion) {
+        m_errMessag = "Shm Ring: segment not initialized or version mismatch";
+        return false;
+    }
+    if (m_shm.size() < ShmDataOffset + (qint64)header->capacity) {
+        m_errMessag = "Shm Ring: segment smaller than capacity";
+        return false;
+    }
+
+    m_header = header;
+    m_capacity = header->capacity;
+    m_data = static_cast<char *>(m_shm.data()) + ShmDataOffset;
+    return true;
+}
+
+bool QMqShmRing::Write(const QByteArray &exchange, const QByteArray &routingKey, const QByteArray &body)
+{
+    if (!m_writer || m_header == nullptr) {
+        m_errMessag = "Shm Ring Write: not a writer";
+        return false;
+    }
+    if (m_header->writerPid.load(std::memory_order_relaxed) != m_pid) {
+        this->OnHeartbeatTimeout();
+        return false;
+    }
+
+    uint64_t recordLen = sizeof(MqShmRecord) + exchange.size() + routingKey.size() + body.size();
+    if (exchange.size() > 0xFFFF || routingKey.size() > 0xFFFF || recordLen > m_capacity / 2) {
+        m_errMessag = "Shm Ring Write: message too large";
+        return false;
+    }
+
+    uint64_t pos = m_header->commit.load(std::memory_order_relaxed);
+    uint64_t end = pos + recordLen;
+    if (m_policy == MqShmDropNew && this->WouldOverrun(end)) {
+        m_stats.writeDropped.add();
+        m_errMessag = "Shm Ring Write: reader lagging, message dropped";
+        return false;
+    }
+
+    // 先发布reserve，读端据此判断正在读的数据是否被覆盖
+    m_header->reserve.store(end, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    MqShmRecord record;
+    record.recordLen = (uint32_t)recordLen;
+    record.bodyLen = (uint32_t)body.size();
+    record.exchangeLen = (uint16_t)exchange.size();
+    record.routingKeyLen = (uint16_t)routingKey.size();
+    record.reserved = 0;
+    this->CopyIn(pos, reinterpret_cast<const char *>(&record), sizeof(record));
+    pos += sizeof(record);
+    this->CopyIn(pos, exchange.constData(), record.exchangeLen);
+    pos += record.exchangeLen;
+    this->CopyIn(pos, routingKey.constData(), record.routingKeyLen);
+    pos += record.routingKeyLen;
+    this->CopyIn(pos, body.constData(), record.bodyLen);
+
+    m_header->commit.store(end, std::memory_order_release);
+    m_stats.written.add();
+    return true;
+}
+
+bool QMqShmRing::WouldOverrun(uint64_t end)
+{
+    qint64 now = NowMs();
+    for (int i = 0; i < MaxReaders; i++) {
+        const MqShmReaderSlot &slot = m_header->readers[i];
+        if (slot.active.load(std::memory_order_acquire) == 0 || now - slot.heartbeatMs.load() > m_readerTimeoutMs) {
+            continue;
+        }
+        if (end - slot.cursor.load(std::memory_order_acquire) > m_capacity) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int QMqShmRing::ReadAvailable(int maxCount)
+{
+    if (m_writer || m_header == nullptr || m_readerSlot < 0) {
+        return 0;
+    }
+
+    MqShmReaderSlot &slot = m_header->readers[m_readerSlot];
+    slot.heartbeatMs.store(NowMs());
+
+    // 被覆盖时跳到最新位置
+    auto overrun = [this, &slot](uint64_t commit) {
+        qint64 lost = (qint64)(commit - m_cursor);
+        m_cursor = commit;
+        slot.cursor.store(m_cursor, std::memory_order_release);
+        m_stats.overruns.add();
+        m_stats.lostBytes.add(lost);
+        emit sigShmOverrun(lost);
+    };
+    auto overwritten = [this]() {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_header->reserve.load(std::memory_order_relaxed) - m_cursor > m_capacity;
+    };
+
+    int count = 0;
+    while (count < maxCount && m_header) {
+        uint64_t commit = m_header->commit.load(std::memory_order_acquire);
+        if (m_cursor == commit) {
+            break;
+        }
+        if (commit - m_cursor > m_capacity || commit - m_cursor < sizeof(MqShmRecord)) {
+            overrun(commit);
+            continue;
+        }
+
+        MqShmRecord record;
+        this->CopyOut(m_cursor, reinterpret_cast<char *>(&record), sizeof(record));
+        if (overwritten()) {
+            overrun(commit);
+            continue;
+        }
+        if (record.recordLen != sizeof(MqShmRecord) + record.exchangeLen + record.routingKeyLen + record.bodyLen
+                || record.recordLen > commit - m_cursor) {
+            overrun(commit);
+            continue;
+        }
+
+        uint64_t pos = m_cursor + sizeof(record);
+        QByteArray exchange(record.exchangeLen, Qt::Uninitialized);
+        this->CopyOut(pos, exchange.data(), record.exchangeLen);
+        pos += record.exchangeLen;
+        QByteArray routingKey(record.routingKeyLen, Qt::Uninitialized);
+        this->CopyOut(pos, routingKey.data(), record.routingKeyLen);
+        pos += record.routingKeyLen;
+        QByteArray body(record.bodyLen, Qt::Uninitialized);
+        this->CopyOut(pos, body.data(), record.bodyLen);
+        if (overwritten()) {
+            overrun(commit);
+            continue;
+        }
+
+        m_cursor += record.recordLen;
+        slot.cursor.store(m_cursor, std::memory_order_release);
+        m_stats.read.add();
+        count++;
+        emit sigShmMessage(exchange, routingKey, body);
+    }
+
+    return count;
+}
+
+void QMqShmRing::CopyIn(uint64_t pos, const char *src, uint32_t size)
+{
+    uint64_t index = pos % m_capacity;
+    uint64_t first = qMin<uint64_t>(size, m_capacity - index);
+    memcpy(m_data + index, src, first);
+    memcpy(m_data, src + first, size - first);
+}
+
+void QMqShmRing::CopyOut(uint64_t pos, char *dest, uint32_t size) const
+{
+    uint64_t index = pos % m_capacity;
+    uint64_t first = qMin<uint64_t>(size, m_capacity - index);
+    memcpy(dest, m_data + index, first);
+    memcpy(dest + first, m_data, size - first);
+}
+
+void QMqShmRing::OnPollTimeout()
+{
+    this->ReadAvailable();
+}
+
+void QMqShmRing::setReaderTimeout(int timeoutMs)
+{
+    m_readerTimeoutMs = timeoutMs;
+}
+
+bool QMqShmRing::isWriter() const
+{
+    return m_writer;
+}
+
+MqShmStats QMqShmRing::getStats() const
+{
+    MqShmStats stats = m_stats;
+    if (m_writer && m_header) {
+        qint64 now = NowMs();
+        int readers = 0;
+        for (int i = 0; i < MaxReaders; i++) {
+            if (m_header->readers[i].active.load() && now - m_header->readers[i].heartbeatMs.load() <= m_readerTimeoutMs) {
+                readers++;
+            }
+        }
+        stats.readers.set(readers);
+    }
+    return stats;
+}
+
+QString QMqShmRing::getErrorMessage() const
+{
+    return m_errMessag;
+}
+
+
+} //namespace AMQP_QT
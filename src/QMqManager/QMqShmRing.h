@@ -0,0 +1,98 @@
+#ifndef QMQSHMRING_H
+#define QMQSHMRING_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QSharedMemory>
+#include <QTimer>
+#include "QMqStats.h"
+
+
+namespace AMQP_QT {
+
+struct MqShmRingHeader;
+
+// 写端追上最慢读端时的处理方式
+enum MqShmOverrunPolicy {
+    MqShmOverwrite = 0, // 写端从不等待，覆盖未读数据，落后的读端跳到最新位置并统计丢失
+    MqShmDropNew = 1    // 会覆盖活跃读端未读数据时丢弃新消息
+};
+
+
+/**
+ * @brief The QMqShmRing class 本机多进程共享的消息环
+ * 一个进程消费broker并写入，同机其他进程各自持有读游标读取，一份订阅供整机使用。
+ * 单写多读，写端不加锁：先发布reserve位置再写数据，最后发布commit位置；
+ * 读端拷贝完数据后检查reserve，发现数据已被覆盖时丢弃本条并跳到commit位置
+ */
+class QMqShmRing : public QObject
+{
+    Q_OBJECT
+public:
+    static const int MaxReaders = 32;
+
+public:
+    explicit QMqShmRing(QObject *parent = nullptr);
+    ~QMqShmRing();
+
+    // 写端创建(或接管已存在的)共享内存，capacity为数据区字节数。
+    // 已有写端且心跳未超时时返回失败，不会两个进程同时写入
+    bool CreateWriter(const QString &key, qint64 capacity, MqShmOverrunPolicy policy = MqShmOverwrite);
+    // 读端连接共享内存，从当前最新位置开始读，pollMs为轮询间隔
+    bool AttachReader(const QString &key, int pollMs = 1);
+    void Detach();
+
+    // 写入一条消息，单条消息不能超过容量的一半
+    bool Write(const QByteArray &exchange, const QByteArray &routingKey, const QByteArray &body);
+    // 读端读取已提交的消息，每条发出sigShmMessage，返回读取条数
+    int ReadAvailable(int maxCount = 1024);
+
+    // 心跳超时时间，超时的读端不再参与丢弃策略的判断，超时的写端可被其他进程接管
+    void setReaderTimeout(int timeoutMs);
+    bool isWriter() const;
+    MqShmStats getStats() const;
+    QString getErrorMessage() const;
+
+signals:
+    void sigShmMessage(const QByteArray &exchange, const QByteArray &routingKey, const QByteArray &body);
+    // 读端落后被覆盖，lostBytes为跳过的数据量
+    void sigShmOverrun(qint64 lostBytes);
+
+private slots:
+    void OnPollTimeout();
+    // 写端定时更新心跳
+    void OnHeartbeatTimeout();
+
+private:
+    bool MapHeader();
+    // 共享内存中登记的写端心跳未超时
+    bool IsWriterAlive() const;
+    // 写入会覆盖活跃读端未读的数据
+    bool WouldOverrun(uint64_t end);
+    void CopyOut(uint64_t pos, char *dest, uint32_t size) const;
+    void CopyIn(uint64_t pos, const char *src, uint32_t size);
+
+private:
+    QSharedMemory m_shm;
+    MqShmRingHeader *m_header = nullptr;
+    char *m_data = nullptr;
+    uint64_t m_capacity = 0;
+    bool m_writer = false;
+    qint64 m_pid = 0;               // 写端登记的本进程号
+    MqShmOverrunPolicy m_policy = MqShmOverwrite;
+
+    int m_readerSlot = -1;
+    uint64_t m_cursor = 0;
+    int m_readerTimeoutMs = 5000;
+    QTimer m_pollTimer;
+    QTimer m_heartbeatTimer;
+
+    MqShmStats m_stats;
+    QString m_errMessag;
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQSHMRING_H
@@ -0,0 +1,228 @@
+#ifndef QMQSTATS_H
+#define QMQSTATS_H
+
+#include <atomic>
+#include <cstdint>
+
+
+namespace AMQP_QT {
+
+
+/**
+ * @brief The MqCounter class 无锁计数器
+ * 写入端只做relaxed原子操作，读取端通过拷贝得到快照，不会阻塞IO线程
+ */
+class MqCounter
+{
+public:
+    MqCounter(uint64_t val = 0) : m_value(val) {}
+    MqCounter(const MqCounter &other) : m_value(other.load()) {}
+    MqCounter &operator=(const MqCounter &other) { m_value.store(other.load(), std::memory_order_relaxed); return *this; }
+
+    void add(uint64_t val = 1) { m_value.fetch_add(val, std::memory_order_relaxed); }
+    void sub(uint64_t val = 1) { m_value.fetch_sub(val, std::memory_order_relaxed); }
+    void set(uint64_t val) { m_value.store(val, std::memory_order_relaxed); }
+    // 仅在新值更大时更新，用于记录最大值
+    void setMax(uint64_t val)
+    {
+        uint64_t cur = load();
+        while (cur < val && !m_value.compare_exchange_weak(cur, val, std::memory_order_relaxed)) {}
+    }
+    uint64_t load() const { return m_value.load(std::memory_order_relaxed); }
+    operator uint64_t() const { return load(); }
+
+private:
+    std::atomic<uint64_t> m_value;
+};
+
+
+/**
+ * @brief The MqLatencyStats class 延迟统计，单位:微秒
+ * 按2的幂分桶，percentile()返回所在桶的上界，足够观察p50/p99的变化趋势
+ */
+class MqLatencyStats
+{
+public:
+    static const int BucketCount = 32;
+
+    void record(uint64_t us)
+    {
+        int idx = 0;
+        while (idx < BucketCount - 1 && (1ull << idx) < us) {
+            idx++;
+        }
+        m_buckets[idx].add();
+        count.add();
+        sumUs.add(us);
+        maxUs.setMax(us);
+    }
+
+    // 估算分位数，ratio取值(0,1]，如0.99
+    uint64_t percentile(double ratio) const
+    {
+        uint64_t total = count.load();
+        if (total == 0) {
+            return 0;
+        }
+
+        uint64_t target = (uint64_t)(total * ratio);
+        if (target == 0) {
+            target = 1;
+        }
+
+        uint64_t seen = 0;
+        for (int i = 0; i < BucketCount; i++) {
+            seen += m_buckets[i].load();
+            if (seen >= target) {
+                uint64_t bound = 1ull << i;
+                return bound < maxUs.load() ? bound : maxUs.load();
+            }
+        }
+        return maxUs.load();
+    }
+
+    uint64_t average() const
+    {
+        uint64_t total = count.load();
+        return total == 0 ? 0 : sumUs.load() / total;
+    }
+
+    MqCounter count;
+    MqCounter sumUs;
+    MqCounter maxUs;
+
+private:
+    MqCounter m_buckets[BucketCount];
+};
+
+
+/**
+ * @brief The MqLaneStats struct 发送通道(lane)统计
+ */
+struct MqLaneStats
+{
+    MqCounter frames;           // 已写入socket的帧数
+    MqCounter bytes;            // 已写入socket的字节数
+    MqCounter queuedFrames;     // 当前排队中的帧数
+    MqCounter queuedBytes;      // 当前排队中的字节数
+    MqCounter conflated;        // 排队期间被同key新消息替换掉的消息数
+    MqLatencyStats latency;     // 帧从入队到写入socket的等待时间
+};
+
+
+/**
+ * @brief The MqConsumerStats struct 消费端统计
+ */
+struct MqConsumerStats
+{
+    MqCounter received;         // 收到的消息数
+    MqCounter dispatched;       // 分发给应用的消息数
+    MqCounter acked;            // ack的消息数
+    MqCounter rejected;         // reject的消息数
+    MqCounter bufferedMessages; // 本地缓冲中的消息数
+    MqCounter bufferedBytes;    // 本地缓冲中的字节数
+    MqCounter unackedMessages;  // 已分发未ack的消息数
+    MqCounter unackedBytes;     // 已分发未ack的字节数
+    MqCounter pauseCount;       // 因超过高水位暂停投递的次数
+    MqCounter pausedMs;         // 累计暂停时间
+    MqCounter retried;          // 本地延迟重试的次数
+    MqCounter retryHeld;        // 当前等待重试的消息数
+    MqCounter deadLettered;     // 重试耗尽转入死信的消息数
+    MqCounter conflated;        // 合并模式下被同key新消息替换、直接ack的消息数
+    MqCounter channelRecoveries; // 在原连接上重建channel的次数
+    MqCounter filterPassed;     // 通过消费过滤的消息数
+    MqCounter filterDropped;    // 被消费过滤丢弃、直接ack的消息数
+    MqCounter filterDroppedBytes; // 被丢弃消息的body字节数，这部分未拷贝
+    MqCounter dedupChecked;     // 查询去重窗口的消息数
+    MqCounter dedupDropped;     // 已处理过、直接ack不再分发的重复消息数
+    MqCounter inlineHandled;    // 由内联处理函数处理(ack或reject)的消息数
+    MqCounter expired;          // 分发前已过期、未交给应用的消息数
+    MqCounter expiredBytes;     // 过期消息的body字节数
+};
+
+
+/**
+ * @brief The MqConnectionStats struct 连接统计
+ */
+struct MqConnectionStats
+{
+    MqCounter connects;         // 成功建立连接的次数，大于1说明发生过重连
+    MqCounter connectErrors;    // 连接或channel出错导致实例关闭的次数
+};
+
+
+/**
+ * @brief The MqShmStats struct 共享内存环统计，写端和读端各自统计
+ */
+struct MqShmStats
+{
+    MqCounter written;          // 写入的消息数
+    MqCounter writeDropped;     // 丢弃策略下因读端未跟上而丢弃的消息数
+    MqCounter read;             // 读取的消息数
+    MqCounter overruns;         // 读端被写端追上(数据被覆盖)的次数
+    MqCounter lostBytes;        // 被覆盖而跳过的字节数
+    MqCounter readers;          // 写端看到的活跃读端数
+};
+
+
+/**
+ * @brief The MqDnsStats struct 域名解析统计
+ */
+struct MqDnsStats
+{
+    MqCounter lookups;          // 实际发起的解析次数(含预取)
+    MqCounter cacheHits;        // 命中缓存的次数
+    MqCounter negativeHits;     // 命中失败缓存、直接返回失败的次数
+    MqCounter staleHits;        // 过期后先用旧地址、后台刷新的次数
+    MqCounter failures;         // 解析失败次数
+    MqCounter prefetches;       // 到期前后台预取的次数
+    MqLatencyStats latency;     // 解析耗时
+};
+
+
+/**
+ * @brief The MqTlsStats struct TLS握手统计，按是否携带session ticket区分完整握手和会话恢复
+ */
+struct MqTlsStats
+{
+    MqCounter fullHandshakes;   // 完整握手次数
+    MqCounter resumeAttempts;   // 携带缓存ticket的握手次数
+    MqCounter failures;         // 握手失败次数
+    MqLatencyStats fullLatency;     // 完整握手耗时
+    MqLatencyStats resumedLatency;  // 会话恢复握手耗时
+    MqLatencyStats fullCpu;         // 完整握手期间的进程CPU时间
+    MqLatencyStats resumedCpu;      // 会话恢复握手期间的进程CPU时间
+};
+
+
+/**
+ * @brief The MqTxStats struct 事务批量发布统计
+ */
+struct MqTxStats
+{
+    MqCounter committedBatches; // 提交成功的批次数
+    MqCounter committedMessages; // 提交成功的消息数
+    MqCounter failedBatches;    // 提交失败或随channel丢弃的批次数
+    MqCounter failedMessages;   // 失败批次中的消息数
+    MqCounter inFlightCommits;  // 已发出commit、尚未收到结果的批次数
+    MqLatencyStats commitLatency; // commit发出到收到commit-ok的时间
+};
+
+
+/**
+ * @brief The MqArchiveStats struct 消息录制与回放统计
+ */
+struct MqArchiveStats
+{
+    MqCounter records;          // 录制的消息数
+    MqCounter bytes;            // 录制写入的字节数(含记录头)
+    MqCounter segments;         // 打开过的段数
+    MqCounter failures;         // 录制失败的消息数
+    MqCounter replayed;         // 回放发出的消息数
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQSTATS_H
@@ -0,0 +1,148 @@
+#include "QMqTimerWheel.h"
+
+
+namespace AMQP_QT {
+
+QMqTimerWheel::QMqTimerWheel(int tickMs)
+    : m_tickMs(tickMs > 0 ? tickMs : 1)
+{
+    //
+}
+
+int QMqTimerWheel::tickMs() const
+{
+    return m_tickMs;
+}
+
+void QMqTimerWheel::schedule(uint64_t id, qint64 delayMs)
+{
+    // 至少等待一个tick
+    uint64_t ticks = delayMs <= 0 ? 1 : (uint64_t)((delayMs + m_tickMs - 1) / m_tickMs);
+    uint64_t expireTick = m_currentTick + ticks;
+
+    m_expireTicks.insert(id, expireTick);
+    this->insert(id, expireTick);
+}
+
+bool QMqTimerWheel::cancel(uint64_t id)
+{
+    // 槽中的旧项在到期时被忽略
+    return m_expireTicks.remove(id) > 0;
+}
+
+void QMqTimerWheel::insert(uint64_t id, uint64_t expireTick)
+{
+    uint64_t diff = expireTick > m_currentTick ? expireTick - m_currentTick : 0;
+
+    int level = 0;
+    while (level < LevelCount - 1 && diff >= (1ull << (SlotBits * (level + 1)))) {
+        level++;
+    }
+
+    // 超出最高层范围的定时器放在最高层最远的槽，下放时再重新计算
+    uint64_t maxTick = m_currentTick + (1ull << (SlotBits * LevelCount)) - 1;
+    uint64_t tick = expireTick < maxTick ? expireTick : maxTick;
+    int slot = (int)((tick >> (SlotBits * level)) & (SlotCount - 1));
+    m_slots[level][slot].push_back(id);
+}
+
+int QMqTimerWheel::cascade(int level)
+{
+    int slot = (int)((m_currentTick >> (SlotBits * level)) & (SlotCount - 1));
+    std::vector<uint64_t> ids;
+    ids.swap(m_slots[level][slot]);
+
+    for (uint64_t id : ids) {
+        auto it = m_expireTicks.find(id);
+        if (it != m_expireTicks.end()) {
+            this->insert(id, it.value());
+        }
+    }
+    return slot;
+}
+
+QList<uint64_t> QMqTimerWheel::advance(qint64 nowMs)
+{
+    QList<uint64_t> expired;
+    uint64_t targetTick = nowMs <= 0 ? 0 : (uint64_t)(nowMs / m_tickMs);
+
+    while (m_currentTick < targetTick) {
+        m_currentTick++;
+
+        // 第0层转满一圈时，依次把上层的槽下放
+        int slot = (int)(m_currentTick & (SlotCount - 1));
+        for (int level = 1; level < LevelCount && slot == 0; level++) {
+            slot = this->cascade(level);
+        }
+
+        std::vector<uint64_t> ids;
+        ids.swap(m_slots[0][m_currentTick & (SlotCount - 1)]);
+        for (uint64_t id : ids) {
+            auto it = m_expireTicks.find(id);
+            if (it == m_expireTicks.end()) {
+                continue;
+            }
+            if (it.value() > m_currentTick) {
+                // 同一槽中下一圈才到期的定时器
+                this->insert(id, it.value());
+                continue;
+            }
+            m_expireTicks.erase(it);
+            expired.append(id);
+        }
+
+        // 没有等待中的定时器，直接跳到目标时间
+        if (m_expireTicks.isEmpty()) {
+            this->clear();
+            m_currentTick = targetTick;
+        }
+    }
+
+    return expired;
+}
+
+qint64 QMqTimerWheel::nextExpireMs() const
+{
+    if (m_expireTicks.isEmpty()) {
+        return -1;
+    }
+
+    // 每层从当前位置之后找第一个非空槽，取各层中最早的槽起始tick
+    uint64_t nextTick = UINT64_MAX;
+    for (int level = 0; level < LevelCount; level++) {
+        uint64_t base = m_currentTick >> (SlotBits * level);
+        for (uint64_t i = 1; i <= (uint64_t)SlotCount; i++) {
+            if (!m_slots[level][(base + i) & (SlotCount - 1)].empty()) {
+                nextTick = qMin(nextTick, (base + i) << (SlotBits * level));
+                break;
+            }
+        }
+    }
+    if (nextTick == UINT64_MAX) {
+        nextTick = m_currentTick + 1;
+    }
+    return (qint64)nextTick * m_tickMs;
+}
+
+int QMqTimerWheel::size() const
+{
+    return m_expireTicks.size();
+}
+
+bool QMqTimerWheel::isEmpty() const
+{
+    return m_expireTicks.isEmpty();
+}
+
+void QMqTimerWheel::clear()
+{
+    for (int level = 0; level < LevelCount; level++) {
+        for (int slot = 0; slot < SlotCount; slot++) {
+            m_slots[level][slot].clear();
+        }
+    }
+    m_expireTicks.clear();
+}
+
+
+} //namespace AMQP_QT
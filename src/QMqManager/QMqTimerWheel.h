@@ -0,0 +1,57 @@
+#ifndef QMQTIMERWHEEL_H
+#define QMQTIMERWHEEL_H
+
+#include <QHash>
+#include <QList>
+#include <vector>
+
+
+namespace AMQP_QT {
+
+
+/**
+ * @brief The QMqTimerWheel class 分层时间轮
+ * 4层，每层64个槽；第0层一个槽对应一个tick，上层的槽在下层转满一圈时下放(cascade)。
+ * 定时器只保存id，插入、取消都是O(1)，适合大量同时等待的延迟重试
+ */
+class QMqTimerWheel
+{
+public:
+    explicit QMqTimerWheel(int tickMs = 10);
+
+    int tickMs() const;
+    // 添加定时器，delayMs后到期；同一id重复添加时以最后一次为准
+    void schedule(uint64_t id, qint64 delayMs);
+    // 取消定时器
+    bool cancel(uint64_t id);
+    // 时间推进到nowMs(从时间轮创建开始计时)，返回到期的id
+    QList<uint64_t> advance(qint64 nowMs);
+    // 下一次可能有定时器到期的时间(与advance的nowMs同一基准)，没有定时器时返回-1。
+    // 上层的槽只能精确到槽的起始时间，届时advance下放后再取一次即可
+    qint64 nextExpireMs() const;
+
+    int size() const;
+    bool isEmpty() const;
+    void clear();
+
+private:
+    void insert(uint64_t id, uint64_t expireTick);
+    // 把上层槽中的定时器重新放入时间轮，返回该层的槽序号
+    int cascade(int level);
+
+private:
+    static const int SlotBits = 6;
+    static const int SlotCount = 1 << SlotBits;
+    static const int LevelCount = 4;
+
+    int m_tickMs;
+    uint64_t m_currentTick = 0;
+    std::vector<uint64_t> m_slots[LevelCount][SlotCount];
+    QHash<uint64_t, uint64_t> m_expireTicks;   // id -> 到期tick，取消或重复添加后槽中的旧项失效
+};
+
+
+} //namespace AMQP_QT
+
+
+#endif // QMQTIMERWHEEL_H
@@ -1,23 +1,72 @@
 #include "QRabbitmqMgr.h"
 #include <QThread>
 #include <QMutexLocker>
+#include <QUuid>
+#include <QDateTime>
+#include <climits>
 #include "amqpcpp.h"
 #include "QTcpConnectionHandler.h"
+#include "QMqFrameEncoder.h"
+#include "QMqDnsCache.h"
 
 
 using namespace std;
 
 namespace AMQP_QT {
 
+namespace {
+
+// 主channel和bulk channel在重建时的编号，分片channel使用其序号
+const int MqMainChannel = -1;
+const int MqBulkChannel = -2;
+// tx channel从该编号起依次向下编号
+const int MqTxChannel = -3;
+
+// 回放时发送队列积压超过该值就暂停读取
+const qint64 MqReplayMaxQueuedBytes = 4 * 1024 * 1024;
+
+// deliveryTag低48位为broker的tag，高16位为channel代数
+const int MqTagGenerationShift = 48;
+const uint64_t MqBrokerTagMask = (1ULL << MqTagGenerationShift) - 1;
+
+} //namespace
+
+
+/**
+ * @brief The MqStagedMessage class 过滤模式下自行组装的消息，与AMQP-CPP内部组装方式一致：
+ * body只有一帧时直接引用帧数据，多帧时才分配缓冲
+ */
+class MqStagedMessage : public AMQP::Message
+{
+public:
+    MqStagedMessage(const std::string &exchange, const std::string &routingKey) : AMQP::Message(exchange, routingKey) {}
+
+    void setMeta(const AMQP::MetaData &meta, uint64_t bodySize)
+    {
+        AMQP::MetaData::operator=(meta);
+        this->setBodySize(bodySize);
+    }
+
+    void appendData(const char *data, size_t size)
+    {
+        this->append(data, size);
+    }
+};
+
 QRabbitmqMgr::QRabbitmqMgr(const MqInfo &mqinfo, MqRoles role, int hbInterval)
   : QObject(nullptr), m_role(role), m_heartbeatInterval(hbInterval)
 {
-    this->Init(mqinfo);
+    m_initOk = this->Init(mqinfo);
 }
 
 QRabbitmqMgr::~QRabbitmqMgr()
 {
+    // 之后到达的回调一律忽略
+    m_alive.reset();
     this->ReleaseMqInstance();
+    if (!m_mqInfo.metricsName.isEmpty()) {
+        QMqMetricsExporter::Unregister(this);
+    }
 }
 
 bool QRabbitmqMgr::Init(const MqInfo &mqInfo)
@@ -28,31 +77,121 @@ bool QRabbitmqMgr::Init(const MqInfo &mqInfo)
         m_heartbeatInterval = 0;
     }
 
+    m_deliveryBuffer.setWatermarks(m_mqInfo.bufferHighBytes, m_mqInfo.bufferLowBytes,
+                                   m_mqInfo.bufferHighMessages, m_mqInfo.bufferLowMessages);
+    m_consumeQueues = m_mqInfo.consumeQueues;
+    if (m_consumeQueues.isEmpty()) {
+        MqQueueInfo queue;
+        queue.queueName = m_mqInfo.queueName;
+        queue.bindingKey = m_mqInfo.bindingKey;
+        m_consumeQueues.append(queue);
+    }
+    QVector<int> weights;
+    for (const MqQueueInfo &queue : m_consumeQueues) {
+        weights.append(queue.weight);
+    }
+    m_deliveryBuffer.setQueueWeights(weights, m_mqInfo.schedulePolicy);
+    m_deliveryBuffer.setPriorityLevels(m_mqInfo.priorityLevels);
+    m_dispatchTimer.setSingleShot(true);
+    connect(&m_dispatchTimer, &QTimer::timeout, this, &QRabbitmqMgr::OnDispatchDeliveries);
+    m_retryTimer.setSingleShot(true);
+    connect(&m_retryTimer, &QTimer::timeout, this, &QRabbitmqMgr::OnRetryTick);
+    m_recoverTimer.setSingleShot(true);
+    connect(&m_recoverTimer, &QTimer::timeout, this, &QRabbitmqMgr::OnRecoverChannels);
+    m_txLingerTimer.setSingleShot(true);
+    connect(&m_txLingerTimer, &QTimer::timeout, this, &QRabbitmqMgr::OnTxLingerTimeout);
+    m_txClock.start();
+    m_replayTimer.setSingleShot(true);
+    connect(&m_replayTimer, &QTimer::timeout, this, &QRabbitmqMgr::OnReplayTick);
+    m_chunkTimer.setSingleShot(true);
+    connect(&m_chunkTimer, &QTimer::timeout, this, &QRabbitmqMgr::OnChunkPump);
+    m_retryClock.start();
+
+    // 提前异步解析broker域名，连接时通常已在缓存中
+    QMqDnsCache::instance()->Prefetch(m_mqInfo.ip);
+
+    // 以下为按配置启用的功能，任一初始化失败时StartMqInstance直接返回失败
+    if((m_role & MqConsumer) && m_mqInfo.enableChunkAssemble) {
+        m_pChunkAssembler = make_shared<QMqChunkAssembler>();
+        m_pChunkAssembler->setOutputDir(m_mqInfo.chunkOutputDir);
+        m_pChunkAssembler->setTimeout(m_mqInfo.chunkTimeoutMs);
+        m_pChunkAssembler->setMaxTotalSize(m_mqInfo.chunkMaxTotalBytes);
+    }
+
+    if((m_role & MqConsumer) && m_mqInfo.dedupEnabled) {
+        m_pDedupCache = make_shared<QMqDedupCache>(m_mqInfo.dedupWindow);
+        if (!m_mqInfo.dedupPersistFile.isEmpty() && !m_pDedupCache->OpenPersist(m_mqInfo.dedupPersistFile)) {
+            m_errMessag = m_pDedupCache->getErrorMessage();
+            m_pDedupCache = nullptr;
+            return false;
+        }
+    }
+
+    if((m_role & MqConsumer) && !m_mqInfo.archiveDir.isEmpty()) {
+        m_pArchiveWriter = make_shared<QMqArchiveWriter>();
+        if (!m_pArchiveWriter->Open(m_mqInfo.archiveDir, m_mqInfo.archiveSegmentBytes)) {
+            m_errMessag = m_pArchiveWriter->getErrorMessage();
+            m_pArchiveWriter = nullptr;
+            return false;
+        }
+    }
+
+    if((m_role & MqConsumer) && !m_mqInfo.shmFanoutKey.isEmpty()) {
+        m_pShmRing = make_shared<QMqShmRing>();
+        if (!m_pShmRing->CreateWriter(m_mqInfo.shmFanoutKey, m_mqInfo.shmFanoutBytes, m_mqInfo.shmOverrunPolicy)) {
+            m_errMessag = m_pShmRing->getErrorMessage();
+            m_pShmRing = nullptr;
+            return false;
+        }
+    }
+
+    if (!m_mqInfo.metricsName.isEmpty()
+            && !QMqMetricsExporter::Register(this, m_mqInfo.metricsName, this->MetricsSources(), m_errMessag)) {
+        return false;
+    }
+
     return true;
 }
 
 bool QRabbitmqMgr::StartMqInstance()
 {
-    try {
-        m_pTcpClient = make_shared<QTcpClient>(m_mqInfo.ip, m_mqInfo.port);
-        connect(m_pTcpClient.get(), &QTcpClient::sigParseTcpMsg, this, &QRabbitmqMgr::OnParseTcpMessage);
-        connect(m_pTcpClient.get(), &QTcpClient::sigSocketErr, this, &QRabbitmqMgr::OnTcpErrHandle);
+    // 配置的功能未能启用时不连接，m_errMessag中保留Init的错误
+    if (!m_initOk) {
+        qCritical() << __FUNCTION__ << m_errMessag;
+        return false;
+    }
 
-        // 等待tcp连接建立成功
-        if (!m_pTcpClient->NewConnect()) {
-            m_errMessag = "Connect MqSever Failed";
-            return false;
+    try {
+        // 共享连接时从注册表获取，否则独占一条连接
+        if (m_mqInfo.shareConnection) {
+            m_connChannels = this->ChannelsNeeded();
+            m_pConn = QMqConnectionRegistry::Acquire(m_mqInfo.ip, m_mqInfo.port, m_mqInfo.vhost,
+                                                     m_mqInfo.loginName, m_mqInfo.loginPwd, m_mqInfo.tls, m_heartbeatInterval,
+                                                     m_connChannels, m_mqInfo.maxChannelsPerConnection, m_errMessag);
+            if (!m_pConn) {
+                return false;
+            }
+        }
+        else {
+            m_pConn = make_shared<QMqConnection>(m_mqInfo.ip, m_mqInfo.port, m_mqInfo.vhost,
+                                                 m_mqInfo.loginName, m_mqInfo.loginPwd, m_heartbeatInterval);
+            m_pConn->setTlsConfig(m_mqInfo.tls);
+            if (!m_pConn->Open()) {
+                m_errMessag = m_pConn->getErrorMessage();
+                m_pConn = nullptr;
+                return false;
+            }
+        }
+        connect(m_pConn.get(), &QMqConnection::sigSocketErr, this, &QRabbitmqMgr::OnTcpErrHandle);
+        m_pTcpClient = m_pConn->getTcpClient();
+        connect(m_pTcpClient.get(), &QTcpClient::sigOutputWritten, this, &QRabbitmqMgr::OnChunkPump, Qt::UniqueConnection);
+        m_pHandler = m_pConn->getHandler();
+        m_connection = m_pConn->getConnection();
+        if (!m_mqInfo.metricsName.isEmpty()) {
+            QMqMetricsExporter::Update(this, this->MetricsSources());
         }
 
-        // 创建handler对象
-        m_pHandler = make_shared<QTcpConnectionHandler>(m_pTcpClient);
-        m_pHandler->setHeartbeatInterval(m_heartbeatInterval); //设置心跳
-        connect(m_pHandler.get(), &QTcpConnectionHandler::sigStartHeartbeatTimer, this, &QRabbitmqMgr::OnStartHeartbeatTimer);
-
-        // 创建connection对象，开始登录Rmq
-        m_connection = std::make_shared<AMQP::Connection>(m_pHandler.get(),
-                                                          AMQP::Login(m_mqInfo.loginName.toStdString(), m_mqInfo.loginPwd.toStdString()),
-                                                          m_mqInfo.vhost.toStdString());
+        m_connStats->connects.add();
 
         // 创建channel
         if(!this->CreateMqChannel()) {
@@ -68,6 +207,11 @@ bool QRabbitmqMgr::StartMqInstance()
 }
 
 bool QRabbitmqMgr::PublishMsg(const QString &msg)
+{
+    return this->PublishData(msg.toUtf8(), MqLaneControl);
+}
+
+bool QRabbitmqMgr::PublishData(const QByteArray &data, MqLane lane)
 {
     if(!(m_role & MqPublisher)) {
         m_errMessag = "Publish Messsage: MqRole is not Publisher";
@@ -82,7 +226,9 @@ bool QRabbitmqMgr::PublishMsg(const QString &msg)
         //注意: 单通道无法支撑较大的数据流量，多线程发送需要加锁
         QMutexLocker channelLocker(&m_channelMutex);
         QString realRouteKey = m_mqInfo.routingKey.isEmpty()? m_mqInfo.queueName : m_mqInfo.routingKey;
-        m_channel->publish(m_mqInfo.exchangeName.toStdString(), realRouteKey.toStdString(), msg.toStdString());
+        // bulk通道的帧由输出调度与控制帧交错发送
+        std::shared_ptr<AMQP::Channel> channel = (lane == MqLaneBulk && m_bulkChannel) ? m_bulkChannel : m_channel;
+        channel->publish(m_mqInfo.exchangeName.toStdString(), realRouteKey.toStdString(), data.constData(), data.size());
     }
     catch (const std::exception &e) {
         m_errMessag = "Publish Messsage: " + QString(e.what());
@@ -92,293 +238,1586 @@ bool QRabbitmqMgr::PublishMsg(const QString &msg)
     return true;
 }
 
-void QRabbitmqMgr::ReleaseMqInstance()
+bool QRabbitmqMgr::PublishChunked(const QByteArray &data, QString &transferId, const QList<uint32_t> &chunks)
 {
-    try {
-        this->CloseMqChannel();
-        this->CloseMqConnection();
-
-        if(m_heartbeatTimer) {
-            m_heartbeatTimer->stop();
-        }
+    if(!(m_role & MqPublisher)) {
+        m_errMessag = "Publish Chunked: MqRole is not Publisher";
+        return false;
     }
-    catch (const std::exception &e) {
-        m_errMessag = "Release MqInstance Failed: " + QString(e.what());
+    if(m_chunkChannels.empty() || m_mqInfo.chunkSize == 0) {
+        m_errMessag = "Publish Chunked: chunk channels not enabled";
+        return false;
     }
-}
 
-void QRabbitmqMgr::BindQueueExchange()
-{
-    if (!CreateMqExchange(m_mqInfo.exchangeName, m_mqInfo.exchangeType)) {
-        this->OnPrintErrMsg(m_errMessag);
+    if (data.isEmpty()) {
+        m_errMessag = "Publish Chunked: data is empty";
+        return false;
     }
 
-    if (!CreateMqQueue(m_mqInfo.queueName)) {
-        this->OnPrintErrMsg(m_errMessag);
+    if (transferId.isEmpty()) {
+        transferId = QUuid::createUuid().toString(QUuid::WithoutBraces);
     }
 
-    if (!BindQueue(m_mqInfo.queueName, m_mqInfo.exchangeName, m_mqInfo.bindingKey)) {
-        this->OnPrintErrMsg(m_errMessag);
+    ChunkTransfer transfer;
+    transfer.data = data;
+    transfer.info.transferId = transferId;
+    transfer.info.totalSize = (uint64_t)data.size();
+    transfer.info.count = (uint32_t)((transfer.info.totalSize + m_mqInfo.chunkSize - 1) / m_mqInfo.chunkSize);
+    for (uint32_t index : chunks) {
+        if (index < transfer.info.count) {
+            transfer.pending.append(index);
+        }
+    }
+    if (chunks.isEmpty()) {
+        for (uint32_t i = 0; i < transfer.info.count; i++) {
+            transfer.pending.append(i);
+        }
     }
-}
 
-QString QRabbitmqMgr::getErrorMessage() const
-{
-    return m_errMessag;
+    // 一次全部交给AMQP-CPP会在lane队列中再保存一份完整数据，这里只排队，由发送队列的余量驱动
+    m_chunkTransfers.enqueue(transfer);
+    this->OnChunkPump();
+    return true;
 }
 
-void QRabbitmqMgr::OnStatusChange(const bool isOk)
+void QRabbitmqMgr::OnChunkPump()
 {
-    if (isOk) {
-        m_mqConnErrIndex = 0;
+    if (m_chunkTransfers.isEmpty() || !m_pTcpClient) {
         return;
     }
 
-    m_mqConnErrIndex++;
-    qCritical() << "QRabbitmqMgr::OnStatusChange, error:" << m_errMessag
-                << ", count:" << m_mqConnErrIndex;
-
-    emit sigMqConnectError();
-    this->CloseMqChannel();
-    m_role = MqRoles::MqNone;
-}
+    QString realRouteKey = m_mqInfo.routingKey.isEmpty()? m_mqInfo.queueName : m_mqInfo.routingKey;
+    std::string exchange = m_mqInfo.exchangeName.toStdString();
+    std::string routeKey = realRouteKey.toStdString();
+
+    QMutexLocker channelLocker(&m_channelMutex);
+    while (!m_chunkTransfers.isEmpty()) {
+        ChunkTransfer &transfer = m_chunkTransfers.head();
+        QString err;
+        try {
+            while (!transfer.pending.isEmpty()) {
+                if (m_chunkChannels.empty()) {
+                    throw std::runtime_error("chunk channels closed");
+                }
+                // 排队数据超过上限时等socket写出后由sigOutputWritten继续
+                if ((qint64)m_pTcpClient->getLaneStats(MqLaneBulk).queuedBytes.load() >= m_mqInfo.chunkMaxQueuedBytes) {
+                    return;
+                }
+
+                MqChunkInfo info = transfer.info;
+                info.index = transfer.pending.first();
+                info.offset = (uint64_t)info.index * m_mqInfo.chunkSize;
+                uint64_t size = qMin<uint64_t>(m_mqInfo.chunkSize, info.totalSize - info.offset);
+                const char *body = transfer.data.constData() + info.offset;
+                info.crc32 = QMqChunkAssembler::Crc32(body, size);
+
+                // 分片轮流分配到各个channel，帧在bulk通道上交错发出；
+                // channel未就绪时AMQP-CPP在内部缓存，不计入lane队列，等就绪后再发
+                auto &channel = m_chunkChannels[info.index % m_chunkChannels.size()];
+                if (!CanSendEncoded(channel)) {
+                    m_chunkTimer.start(10);
+                    return;
+                }
+
+                // 分片时不额外拷贝原始数据；编码成帧时AMQP-CPP仍会拷贝一次
+                AMQP::Envelope envelope(body, size);
+                AMQP::Table headers;
+                QMqChunkAssembler::FillChunkHeaders(info, headers);
+                envelope.setHeaders(std::move(headers));
+                envelope.setPersistent(true);
+                if (!channel->publish(exchange, routeKey, envelope)) {
+                    throw std::runtime_error("publish failed, chunk " + std::to_string(info.index));
+                }
+                transfer.pending.removeFirst();
+            }
+        }
+        catch (const std::exception &e) {
+            err = "Publish Chunked: " + QString(e.what());
+            this->OnPrintErrMsg(err);
+        }
 
-void QRabbitmqMgr::OnPrintErrMsg(const QString &err)
-{
-    qCritical() << __FUNCTION__ << "mq Error: " << err;
+        QString transferId = transfer.info.transferId;
+        m_chunkTransfers.dequeue();
+        // 应用可能在槽函数中发起新的传输，发信号时不持有锁
+        channelLocker.unlock();
+        emit sigChunkedFinished(transferId, err.isEmpty(), err);
+        channelLocker.relock();
+    }
 }
 
-void QRabbitmqMgr::OnParseTcpMessage(const QByteArray &msg)
+bool QRabbitmqMgr::PublishMany(const AMQP::Envelope &envelope, const QList<MqPublishTarget> &targets, MqLane lane)
 {
-    if (!m_connection || !m_connection->usable()) {
-        return;
+    if(!(m_role & MqPublisher)) {
+        m_errMessag = "Publish Many: MqRole is not Publisher";
+        return false;
+    }
+    if(m_channel == nullptr || m_connection == nullptr) {
+        m_errMessag = "Publish Many: channelPub is null";
+        return false;
     }
 
     try {
-        auto data_size = msg.size();
-        size_t parsed_bytes = 0;
-        auto expected_bytes = m_connection->expected();
-        while (data_size - parsed_bytes >= expected_bytes) {
-            QByteArray tmpBUf = msg.mid(parsed_bytes, parsed_bytes + expected_bytes);
-            parsed_bytes += m_connection->parse(tmpBUf.data(), tmpBUf.size());
-            expected_bytes = m_connection->expected();
+        QMutexLocker channelLocker(&m_channelMutex);
+        std::shared_ptr<AMQP::Channel> channel = (lane == MqLaneBulk && m_bulkChannel) ? m_bulkChannel : m_channel;
+
+        // 通道未就绪或在等待同步应答时AMQP-CPP会缓存待发数据，此时直接写帧会越过这些数据，退回逐个发布
+        if (!CanSendEncoded(channel)) {
+            for (const MqPublishTarget &target : targets) {
+                if (!channel->publish(target.exchangeName.toStdString(), target.routingKey.toStdString(), envelope)) {
+                    m_errMessag = "Publish Many: publish failed, routingKey " + target.routingKey;
+                    return false;
+                }
+            }
+            return true;
         }
 
-        //msg.erase(m_parseBuf.begin(), m_parseBuf.begin() + parsed_bytes);
-    }
-    catch (const std::exception&e) {
-        m_errMessag = "Parse MqData Error: " + QString(e.what());
-        this->OnPrintErrMsg(m_errMessag);
+        uint16_t channelId = channel->id();
+        QByteArray header = QMqFrameEncoder::EncodeContentHeader(channelId, envelope, envelope.bodySize());
+        QList<QByteArray> bodyFrames = QMqFrameEncoder::EncodeBody(channelId, envelope.body(), envelope.bodySize(),
+                                                                   m_connection->maxFrame());
+
+        for (const MqPublishTarget &target : targets) {
+            m_pHandler->SendEncodedFrame(QMqFrameEncoder::EncodePublishMethod(channelId, target.exchangeName.toStdString(),
+                                                                              target.routingKey.toStdString()));
+            m_pHandler->SendEncodedFrame(header);
+            for (const QByteArray &frame : bodyFrames) {
+                m_pHandler->SendEncodedFrame(frame);
+            }
+        }
     }
-}
-
-void QRabbitmqMgr::OnStartHeartbeatTimer(int interval)
-{
-    qDebug() << __FUNCTION__ << " starts.";
-    if(m_heartbeatTimer && m_heartbeatTimer->isActive()) {
-        return;
+    catch (const std::exception &e) {
+        m_errMessag = "Publish Many: " + QString(e.what());
+        return false;
     }
 
-    m_heartbeatTimer = std::make_shared<QTimer>();
-    connect(m_heartbeatTimer.get(), &QTimer::timeout, [this]() {
-        //qDebug() << "starts send heartbeat, ready: " << (m_connection != nullptr);
-
-        if(!m_connection) { return; }
-        m_connection->heartbeat();
-    });
-
-    m_heartbeatTimer->start(1000*interval/3);
+    return true;
 }
 
-void QRabbitmqMgr::OnTcpErrHandle(const QString &err)
+bool QRabbitmqMgr::PublishMany(const QByteArray &data, const QList<MqPublishTarget> &targets, MqLane lane)
 {
-    m_errMessag = err;
-
-    emit sigMqConnectError();
-    this->OnStatusChange(false);
-    this->ReleaseMqInstance();
+    AMQP::Envelope envelope(data.constData(), data.size());
+    return this->PublishMany(envelope, targets, lane);
 }
 
-bool QRabbitmqMgr::CreateMqChannel()
+bool QRabbitmqMgr::PublishConflated(const QString &key, const AMQP::Envelope &envelope, MqLane lane)
 {
-    if(m_role == MqNone) {
-        m_errMessag = "Create Channel Failed: MqRole is None";
+    if(!(m_role & MqPublisher)) {
+        m_errMessag = "Publish Conflated: MqRole is not Publisher";
+        return false;
+    }
+    if(m_channel == nullptr || m_connection == nullptr) {
+        m_errMessag = "Publish Conflated: channelPub is null";
         return false;
     }
 
     try {
-        this->CloseMqChannel();
+        QMutexLocker channelLocker(&m_channelMutex);
+        QString realRouteKey = m_mqInfo.routingKey.isEmpty()? m_mqInfo.queueName : m_mqInfo.routingKey;
+        std::shared_ptr<AMQP::Channel> channel = (lane == MqLaneBulk && m_bulkChannel) ? m_bulkChannel : m_channel;
 
-        m_channel = std::make_shared<AMQP::Channel>(m_connection.get());
-        // 建立成功时回调
-        m_channel->onReady(std::bind(&QRabbitmqMgr::ChannelOkCb, this));
-        // 通道发生错误时调用回调函数
-        m_channel->onError(std::bind(&QRabbitmqMgr::ChannelErrCb, this, std::placeholders::_1));
+        // 帧由AMQP-CPP缓存时无法合并，按普通消息发送
+        if (!CanSendEncoded(channel)) {
+            channel->publish(m_mqInfo.exchangeName.toStdString(), realRouteKey.toStdString(), envelope);
+            return true;
+        }
+
+        // 一条消息的所有帧拼成一个整体入队，替换时不会拆开
+        uint16_t channelId = channel->id();
+        QByteArray message = QMqFrameEncoder::EncodePublishMethod(channelId, m_mqInfo.exchangeName.toStdString(),
+                                                                  realRouteKey.toStdString());
+        message.append(QMqFrameEncoder::EncodeContentHeader(channelId, envelope, envelope.bodySize()));
+        for (const QByteArray &frame : QMqFrameEncoder::EncodeBody(channelId, envelope.body(), envelope.bodySize(),
+                                                                   m_connection->maxFrame())) {
+            message.append(frame);
+        }
+
+        MqLane realLane = (channel == m_bulkChannel) ? MqLaneBulk : MqLaneControl;
+        if (!m_pTcpClient->SendConflated(key, message, realLane)) {
+            m_errMessag = "Publish Conflated: send failed";
+            return false;
+        }
     }
     catch (const std::exception &e) {
-        m_errMessag = "Create Channel Failed: " + QString(e.what());
-        this->OnStatusChange(false);
+        m_errMessag = "Publish Conflated: " + QString(e.what());
         return false;
     }
 
     return true;
 }
 
-bool QRabbitmqMgr::CloseMqChannel()
+bool QRabbitmqMgr::PublishConflated(const QString &key, const QByteArray &data, MqLane lane)
+{
+    AMQP::Envelope envelope(data.constData(), data.size());
+    return this->PublishConflated(key, envelope, lane);
+}
+
+std::shared_ptr<QMqPublisher> QRabbitmqMgr::CreatePublisher(const QString &exchangeName, const QString &routingKey,
+                                                            int flags, const AMQP::MetaData &defaults, MqLane lane)
 {
     try {
-        QMutexLocker channelLocker(&m_channelMutex);
-        if (m_channel && m_channel->usable()) {
-            m_channel->close().onError(std::bind(&QRabbitmqMgr::ChannelCloseErrCb, this, std::placeholders::_1));
-        }
+        return std::make_shared<QMqPublisher>(this, exchangeName.toStdString(), routingKey.toStdString(),
+                                              flags, defaults, lane);
     }
     catch (const std::exception &e) {
-        m_errMessag = "Closing Channel Failed: " + QString(e.what());
-        return false;
+        m_errMessag = "Create Publisher Failed: " + QString(e.what());
+        return nullptr;
     }
-
-    return true;
 }
 
-bool QRabbitmqMgr::CloseMqConnection()
+bool QRabbitmqMgr::PublishBound(QMqPublisher &publisher, const QByteArray &body, const AMQP::MetaData *overrides)
 {
+    if(!(m_role & MqPublisher)) {
+        m_errMessag = "Publish Bound: MqRole is not Publisher";
+        return false;
+    }
+    if(m_channel == nullptr || m_connection == nullptr) {
+        m_errMessag = "Publish Bound: channelPub is null";
+        return false;
+    }
+
     try {
-        if (m_connection && m_connection->usable()) {
-            bool ret = m_connection->close();
-            if (!ret) {
-                m_errMessag = "Closing Conncetion Failed";
-                return ret;
+        QMutexLocker channelLocker(&m_channelMutex);
+        std::shared_ptr<AMQP::Channel> channel = (publisher.lane() == MqLaneBulk && m_bulkChannel) ? m_bulkChannel : m_channel;
+        const AMQP::MetaData &meta = overrides ? *overrides : publisher.defaults();
+
+        // 帧由AMQP-CPP缓存时同样交给它，保证按顺序在channel.open和同步操作之后发出
+        if (!CanSendEncoded(channel)) {
+            AMQP::Envelope envelope(meta, body.constData(), body.size());
+            if (!channel->publish(publisher.exchange(), publisher.routingKey(), envelope, publisher.flags())) {
+                m_errMessag = "Publish Bound: publish failed";
+                return false;
             }
+            return true;
+        }
+
+        uint16_t channelId = channel->id();
+        m_pHandler->SendEncodedFrame(publisher.MethodFrame(channelId));
+        m_pHandler->SendEncodedFrame(overrides ? QMqFrameEncoder::EncodeContentHeader(channelId, *overrides, body.size())
+                                               : publisher.HeaderFrame(channelId, body.size()));
+        for (const QByteArray &frame : QMqFrameEncoder::EncodeBody(channelId, body.constData(), body.size(),
+                                                                   m_connection->maxFrame())) {
+            m_pHandler->SendEncodedFrame(frame);
         }
     }
     catch (const std::exception &e) {
-        m_errMessag = "Closing Conncetion Failed: " + QString(e.what());
+        m_errMessag = "Publish Bound: " + QString(e.what());
         return false;
     }
 
     return true;
 }
 
-bool QRabbitmqMgr::CreateMqExchange(const QString &exchangeName, const QString &exchangeType)
+bool QRabbitmqMgr::PublishTransacted(const QByteArray &data, quint64 &batchId)
 {
+    if(!(m_role & MqPublisher)) {
+        m_errMessag = "Publish Transacted: MqRole is not Publisher";
+        return false;
+    }
+    if(m_txChannels.empty()) {
+        m_errMessag = "Publish Transacted: tx channel not enabled";
+        return false;
+    }
+
     try {
-        if(exchangeName.isEmpty()) {
-            m_errMessag = "ExchangeName is empty.";
+        QMutexLocker channelLocker(&m_channelMutex);
+        QString realRouteKey = m_mqInfo.routingKey.isEmpty()? m_mqInfo.queueName : m_mqInfo.routingKey;
+        if (!m_txChannels[m_txCurrent]->publish(m_mqInfo.exchangeName.toStdString(), realRouteKey.toStdString(), data.constData(), data.size())) {
+            m_errMessag = "Publish Transacted: publish failed";
             return false;
         }
 
-        if(!MqExTypeMap.contains(exchangeType)) {
-            m_errMessag = "Create Exchange Failed, Unknow exType: " + exchangeType;
-            return false;
+        batchId = m_txBatchId;
+        m_txBatchMessages++;
+        m_txBatchBytes += data.size();
+        if (m_txBatchMessages == 1) {
+            m_txLingerTimer.start(qMax(0, m_mqInfo.txLingerMs));
         }
-
-        AMQP::ExchangeType type = MqExTypeMap[exchangeType];
-        m_channel->declareExchange(exchangeName.toStdString(), type, AMQP::durable).onError(std::bind(&QRabbitmqMgr::CreatMqExchangeErrCb, this, std::placeholders::_1));
     }
-    catch (const std::exception &e)
-    {
-        m_errMessag = "Create Exchange Failed: " + QString(e.what());
+    catch (const std::exception &e) {
+        m_errMessag = "Publish Transacted: " + QString(e.what());
         return false;
     }
 
+    if (m_txBatchMessages >= m_mqInfo.txBatchMessages
+            || (m_mqInfo.txBatchBytes > 0 && m_txBatchBytes >= m_mqInfo.txBatchBytes)) {
+        return this->CommitTxBatch();
+    }
+
     return true;
 }
 
-bool QRabbitmqMgr::CreateMqQueue(const QString &queueName)
+bool QRabbitmqMgr::CommitTxBatch()
 {
-    try {
-        m_channel->declareQueue(queueName.toStdString(), AMQP::durable).onError(std::bind(&QRabbitmqMgr::CreatMqQueueErrCb, this, std::placeholders::_1));
+    m_txLingerTimer.stop();
+    if (m_txBatchMessages == 0) {
+        return true;
     }
-    catch (const std::exception &e) {
-        m_errMessag = "Create Queue Failed: " + QString(e.what());
+    if(m_txChannels.empty()) {
+        m_errMessag = "Commit Transaction: tx channel not enabled";
         return false;
     }
 
-    return true;
-}
+    quint64 batchId = m_txBatchId;
+    int messages = m_txBatchMessages;
+    m_txBatchId++;
+    m_txBatchMessages = 0;
+    m_txBatchBytes = 0;
 
-bool QRabbitmqMgr::BindQueue(const QString &queueName, const QString &exchangeName, const QString &bindingKey)
-{
     try {
-        if(exchangeName.isEmpty() || queueName.isEmpty()) {
-            m_errMessag = "ExchangeName or QueueName is empty.";
-            return false;
-        }
-
-        QString realBindKey = bindingKey.isEmpty()? queueName : bindingKey;
-        m_channel->bindQueue(exchangeName.toStdString(), queueName.toStdString(), realBindKey.toStdString())
-                .onError(std::bind(&QRabbitmqMgr::BindQueueErrCb, this, std::placeholders::_1));
+        // 同一channel上AMQP-CPP会暂存commit之后的帧直到commit-ok，
+        // 下一批换到另一条tx channel发布，多条channel的commit可同时在途
+        QMutexLocker channelLocker(&m_channelMutex);
+        m_txStats->inFlightCommits.add();
+        std::shared_ptr<AMQP::Channel> channel = m_txChannels[m_txCurrent];
+        m_txCurrent = (m_txCurrent + 1) % (int)m_txChannels.size();
+        channel->commitTransaction()
+                .onSuccess(this->Guarded(std::bind(&QRabbitmqMgr::TxCommitOkCb, this, batchId, messages, m_txClock.nsecsElapsed() / 1000)))
+                .onError(this->Guarded(std::bind(&QRabbitmqMgr::TxCommitErrCb, this, std::placeholders::_1, batchId, messages)));
     }
     catch (const std::exception &e) {
-        m_errMessag = "Bind Queue Failed: " + QString(e.what());
+        m_errMessag = "Commit Transaction: " + QString(e.what());
+        m_txStats->inFlightCommits.sub();
+        this->FailTxBatch(batchId, messages, m_errMessag);
         return false;
     }
 
     return true;
 }
 
-bool QRabbitmqMgr::SetQosValue(const uint16_t val)
+void QRabbitmqMgr::OnTxLingerTimeout()
 {
-    try{
-        m_channel->setQos(val).onError(std::bind(&QRabbitmqMgr::SetQosValueErrCb, this, std::placeholders::_1));
-    }
-    catch (const std::exception &e){
-        m_errMessag = "Set Qos Failed: " + QString(e.what());
-        return false;
+    if (!this->CommitTxBatch()) {
+        this->OnPrintErrMsg(m_errMessag);
     }
-    return true;
 }
 
-bool QRabbitmqMgr::StartConsumeMsg()
+void QRabbitmqMgr::FailTxBatch(quint64 batchId, int messages, const QString &err)
 {
-    if(!(m_role & MqConsumer)) {
-        m_errMessag = "Consume Data Failed: MqRole is not Consumer";
+    m_txStats->failedBatches.add();
+    m_txStats->failedMessages.add(messages);
+    emit sigTxBatchFinished(batchId, messages, false, err);
+}
+
+bool QRabbitmqMgr::StartReplay(const QString &archiveDir, const MqReplayConfig &config)
+{
+    if(!(m_role & MqPublisher)) {
+        m_errMessag = "Start Replay: MqRole is not Publisher";
         return false;
     }
-    if(m_channel == nullptr) {
-        m_errMessag = "Consume Data Failed: channel is null";
+
+    this->StopReplay();
+    std::shared_ptr<QMqArchiveReader> reader = make_shared<QMqArchiveReader>();
+    if (!reader->Open(archiveDir) || (config.fromTimeUs > 0 && !reader->SeekTime(config.fromTimeUs))) {
+        m_errMessag = "Start Replay: " + reader->getErrorMessage();
         return false;
     }
 
-    try {
-        // 自动ack
-        m_channel->consume(m_mqInfo.queueName.toStdString())
-            .onReceived(std::bind(&QRabbitmqMgr::OnConsumeRecved, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3))
-            .onError(std::bind(&QRabbitmqMgr::ConsumeErrorCb, this, std::placeholders::_1));
+    m_pReplayReader = reader;
+    m_replayConfig = config;
+    m_replaySent = 0;
+    m_replayClock.invalidate();
+    m_replayTimer.start(0);
+    return true;
+}
+
+void QRabbitmqMgr::StopReplay()
+{
+    m_replayTimer.stop();
+    m_replayPending = false;
+    // 记录引用reader映射的内存，先于reader释放
+    m_replayRecord = MqArchiveRecord();
+    m_pReplayReader = nullptr;
+}
+
+void QRabbitmqMgr::OnReplayTick()
+{
+    if (!m_pReplayReader) {
+        return;
     }
-    catch (const std::exception &e) {
-        m_errMessag = "Consume Data Failed: " + QString(e.what());
-        return false;
+
+    std::shared_ptr<AMQP::Channel> channel = m_bulkChannel ? m_bulkChannel : m_channel;
+    MqLane lane = m_bulkChannel ? MqLaneBulk : MqLaneControl;
+    if (!channel || !m_connection || !m_pTcpClient) {
+        this->FinishReplay(false, "Replay: channelPub is null");
+        return;
     }
-    return true;
+    // 通道不能直接写帧或发送队列积压时稍后再试，不在内存中堆积回放数据
+    if (!CanSendEncoded(channel) || (qint64)m_pTcpClient->getLaneStats(lane).queuedBytes.load() > MqReplayMaxQueuedBytes) {
+        m_replayTimer.start(1);
+        return;
+    }
+
+    for (int i = 0; i < qMax(1, m_replayConfig.batch); i++) {
+        if (!m_replayPending) {
+            if (!m_pReplayReader->Next(m_replayRecord)) {
+                this->FinishReplay(true, QString());
+                return;
+            }
+            m_replayPending = true;
+        }
+        if (!m_replayClock.isValid()) {
+            m_replayClock.start();
+            m_replayBaseUs = m_replayRecord.timestampUs;
+        }
+
+        // 按录制间隔或固定速率计算本条的发送时间
+        qint64 dueUs = 0;
+        if (m_replayConfig.speed > 0) {
+            dueUs = (qint64)((m_replayRecord.timestampUs - m_replayBaseUs) / m_replayConfig.speed);
+        }
+        else if (m_replayConfig.ratePerSec > 0) {
+            dueUs = m_replaySent * 1000000 / m_replayConfig.ratePerSec;
+        }
+        qint64 nowUs = m_replayClock.nsecsElapsed() / 1000;
+        if (dueUs > nowUs) {
+            m_replayTimer.start((int)qMin<qint64>((dueUs - nowUs) / 1000, 1000));
+            return;
+        }
+
+        // 同一批次中其他调用可能发起了同步操作
+        if (!CanSendEncoded(channel)) {
+            m_replayTimer.start(1);
+            return;
+        }
+        if (!this->PublishRecord(channel, m_replayRecord)) {
+            this->FinishReplay(false, m_errMessag);
+            return;
+        }
+        m_replayPending = false;
+        m_replaySent++;
+        m_replayed->add();
+    }
+
+    m_replayTimer.start(0);
 }
 
-bool QRabbitmqMgr::PurgeMsgQueue()
+bool QRabbitmqMgr::PublishRecord(const std::shared_ptr<AMQP::Channel> &channel, const MqArchiveRecord &record)
 {
     try {
         QMutexLocker channelLocker(&m_channelMutex);
-        if (m_channel && m_channel->usable()) {
-            m_channel->purgeQueue(m_mqInfo.queueName.toStdString());
+        uint16_t channelId = channel->id();
+        std::string exchange = m_replayConfig.exchangeName.isEmpty() ? record.exchange.toStdString()
+                                                                     : m_replayConfig.exchangeName.toStdString();
+
+        // 属性使用录制时的编码，不再解码重建
+        m_pHandler->SendEncodedFrame(QMqFrameEncoder::EncodePublishMethod(channelId, exchange, record.routingKey.toStdString()));
+        m_pHandler->SendEncodedFrame(QMqFrameEncoder::EncodeContentHeader(channelId, record.properties, record.body.size()));
+        for (const QByteArray &frame : QMqFrameEncoder::EncodeBody(channelId, record.body.constData(), record.body.size(),
+                                                                   m_connection->maxFrame())) {
+            m_pHandler->SendEncodedFrame(frame);
         }
     }
     catch (const std::exception &e) {
-        m_errMessag = "Purge Queue Failed: " + QString(e.what());
+        m_errMessag = "Replay Record: " + QString(e.what());
         return false;
     }
 
     return true;
 }
 
-void QRabbitmqMgr::ChannelOkCb()
+void QRabbitmqMgr::FinishReplay(bool ok, const QString &err)
 {
-    this->BindQueueExchange();
-    this->OnStatusChange(true);
+    qint64 sent = m_replaySent;
+    this->StopReplay();
+    emit sigReplayFinished(sent, ok, err);
 }
 
-void QRabbitmqMgr::ChannelErrCb(const char *msg)
+void QRabbitmqMgr::ReleaseMqInstance()
 {
-    m_errMessag = "Channel Error: " + QString(msg);
-    this->OnStatusChange(false);
+    this->StopReplay();
+    // 未发出的分片随连接一起放弃，调用方重连后可指定分片序号补发
+    m_chunkTimer.stop();
+    while (!m_chunkTransfers.isEmpty()) {
+        emit sigChunkedFinished(m_chunkTransfers.dequeue().info.transferId, false, "Publish Chunked: instance released");
+    }
+
+    try {
+        this->CloseMqChannel();
+        this->CloseMqConnection();
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Release MqInstance Failed: " + QString(e.what());
+    }
+}
+
+void QRabbitmqMgr::BindQueueExchange()
+{
+    if (!CreateMqExchange(m_mqInfo.exchangeName, m_mqInfo.exchangeType)) {
+        this->OnPrintErrMsg(m_errMessag);
+    }
+
+    for (const MqQueueInfo &queue : m_consumeQueues) {
+        if (!CreateMqQueue(queue.queueName)) {
+            this->OnPrintErrMsg(m_errMessag);
+        }
+
+        if (!BindQueue(queue.queueName, m_mqInfo.exchangeName, queue.bindingKey)) {
+            this->OnPrintErrMsg(m_errMessag);
+        }
+    }
+}
+
+QString QRabbitmqMgr::getErrorMessage() const
+{
+    return m_errMessag;
+}
+
+MqLaneStats QRabbitmqMgr::getLaneStats(MqLane lane) const
+{
+    if (!m_pTcpClient) {
+        return MqLaneStats();
+    }
+    return m_pTcpClient->getLaneStats(lane);
+}
+
+MqTxStats QRabbitmqMgr::getTxStats() const
+{
+    return *m_txStats;
+}
+
+MqArchiveStats QRabbitmqMgr::getArchiveStats() const
+{
+    MqArchiveStats stats = m_pArchiveWriter ? m_pArchiveWriter->getStats() : MqArchiveStats();
+    stats.replayed = *m_replayed;
+    return stats;
+}
+
+MqTlsStats QRabbitmqMgr::getTlsStats() const
+{
+    if (!m_pTcpClient) {
+        return MqTlsStats();
+    }
+    return m_pTcpClient->getTlsStats();
+}
+
+MqDnsStats QRabbitmqMgr::getDnsStats() const
+{
+    return QMqDnsCache::instance()->getStats();
+}
+
+QMqChunkAssembler *QRabbitmqMgr::getChunkAssembler() const
+{
+    return m_pChunkAssembler.get();
+}
+
+QMqShmRing *QRabbitmqMgr::getShmRing() const
+{
+    return m_pShmRing.get();
+}
+
+MqConsumerStats QRabbitmqMgr::getConsumerStats() const
+{
+    return *m_consumerStats;
+}
+
+MqConnectionStats QRabbitmqMgr::getConnectionStats() const
+{
+    return *m_connStats;
+}
+
+void QRabbitmqMgr::OnStatusChange(const bool isOk)
+{
+    if (isOk) {
+        m_mqConnErrIndex = 0;
+        return;
+    }
+
+    m_mqConnErrIndex++;
+    m_connStats->connectErrors.add();
+    qCritical() << "QRabbitmqMgr::OnStatusChange, error:" << m_errMessag
+                << ", count:" << m_mqConnErrIndex;
+
+    emit sigMqConnectError();
+    this->CloseMqChannel();
+    m_role = MqRoles::MqNone;
+}
+
+void QRabbitmqMgr::OnPrintErrMsg(const QString &err)
+{
+    qCritical() << __FUNCTION__ << "mq Error: " << err;
+}
+
+void QRabbitmqMgr::OnTcpErrHandle(const QString &err)
+{
+    m_errMessag = err;
+
+    emit sigMqConnectError();
+    this->OnStatusChange(false);
+    this->ReleaseMqInstance();
+}
+
+bool QRabbitmqMgr::CreateMqChannel()
+{
+    if(m_role == MqNone) {
+        m_errMessag = "Create Channel Failed: MqRole is None";
+        return false;
+    }
+
+    try {
+        this->CloseMqChannel();
+
+        m_channel = std::make_shared<AMQP::Channel>(m_connection.get());
+        // 建立成功时回调
+        m_channel->onReady(this->Guarded(std::bind(&QRabbitmqMgr::ChannelOkCb, this)));
+        // 通道发生错误时调用回调函数
+        m_channel->onError(this->Guarded(std::bind(&QRabbitmqMgr::ChannelErrCb, this, std::placeholders::_1, MqMainChannel)));
+
+        // 独立的bulk通道，只用于发送
+        if (m_mqInfo.enableBulkLane && (m_role & MqPublisher)) {
+            m_bulkChannel = this->CreateLaneChannel(MqBulkChannel);
+        }
+
+        // 分片并行发送的channel，同样走bulk通道
+        m_chunkChannels.clear();
+        for (int i = 0; (m_role & MqPublisher) && i < m_mqInfo.chunkChannels; i++) {
+            m_chunkChannels.push_back(this->CreateLaneChannel(i));
+        }
+
+        // 事务发布的channel，与普通发布分开，避免其他消息混入事务
+        m_txChannels.clear();
+        m_txCurrent = 0;
+        for (int i = 0; m_mqInfo.txBatchMessages > 0 && (m_role & MqPublisher) && i < qMax(1, m_mqInfo.txChannels); i++) {
+            m_txChannels.push_back(this->CreateTxChannel(i));
+        }
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Create Channel Failed: " + QString(e.what());
+        this->OnStatusChange(false);
+        return false;
+    }
+
+    return true;
+}
+
+std::shared_ptr<AMQP::Channel> QRabbitmqMgr::CreateLaneChannel(int slot)
+{
+    auto channel = std::make_shared<AMQP::Channel>(m_connection.get());
+    channel->onError(this->Guarded(std::bind(&QRabbitmqMgr::ChannelErrCb, this, std::placeholders::_1, slot)));
+    m_pHandler->setChannelLane(channel->id(), MqLaneBulk);
+    return channel;
+}
+
+std::shared_ptr<AMQP::Channel> QRabbitmqMgr::CreateTxChannel(int index)
+{
+    auto channel = std::make_shared<AMQP::Channel>(m_connection.get());
+    channel->onError(this->Guarded(std::bind(&QRabbitmqMgr::TxChannelErrCb, this, std::placeholders::_1, index)));
+    // 开启后该channel上的每次commit都会自动开始下一个事务
+    channel->startTransaction();
+    return channel;
+}
+
+bool QRabbitmqMgr::CloseMqChannel()
+{
+    // 共享连接上channel关闭前仍可能收到在途的消息，先取消consumer；tag在ResetConsumeState中清空
+    try {
+        QMutexLocker channelLocker(&m_channelMutex);
+        if (m_channel && m_channel->usable()) {
+            for (const std::string &consumerTag : m_consumerTags) {
+                m_channel->cancel(consumerTag);
+            }
+        }
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Cancel Consumer Failed: " + QString(e.what());
+    }
+
+    m_recoverTimer.stop();
+    m_recoverSlots.clear();
+    m_consumeOnReady = false;
+    this->ResetConsumeState();
+
+    // 未提交的批次由broker回滚，已发出的commit仍会收到结果
+    m_txLingerTimer.stop();
+    if (m_txBatchMessages > 0) {
+        int messages = m_txBatchMessages;
+        m_txBatchMessages = 0;
+        m_txBatchBytes = 0;
+        this->FailTxBatch(m_txBatchId++, messages, "Channel Closed Before Commit");
+    }
+
+    try {
+        QMutexLocker channelLocker(&m_channelMutex);
+        this->DetachChannel(m_channel);
+        this->DetachChannel(m_bulkChannel);
+        if (m_bulkChannel && m_pHandler) {
+            m_pHandler->setChannelLane(m_bulkChannel->id(), MqLaneControl);
+        }
+        for (auto &channel : m_chunkChannels) {
+            this->DetachChannel(channel);
+            if (m_pHandler) {
+                m_pHandler->setChannelLane(channel->id(), MqLaneControl);
+            }
+        }
+        for (auto &channel : m_txChannels) {
+            this->DetachChannel(channel);
+        }
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Closing Channel Failed: " + QString(e.what());
+        return false;
+    }
+
+    return true;
+}
+
+void QRabbitmqMgr::DetachChannel(const std::shared_ptr<AMQP::Channel> &channel)
+{
+    if (!channel) {
+        return;
+    }
+    // 共享连接不随本实例关闭，channel在收到close-ok之前仍登记在连接上
+    channel->onReady([]() {});
+    channel->onError([](const char *) {});
+    if (channel->usable()) {
+        channel->close().onError(this->Guarded(std::bind(&QRabbitmqMgr::ChannelCloseErrCb, this, std::placeholders::_1)));
+    }
+}
+
+void QRabbitmqMgr::ResetConsumeState()
+{
+    // 通道关闭后deliveryTag失效，未ack的消息由broker重新投递
+    m_dispatchTimer.stop();
+    m_deliveryBuffer.clear();
+    m_unackedDeliveries.clear();
+    m_retryWheel.clear();
+    m_retryAttempts.clear();
+    m_retryHeld.clear();
+    m_supersededTags.clear();
+    m_stagedMessage = nullptr;
+    m_retryTimer.stop();
+    m_consumerStats->retryHeld.set(0);
+    m_consumerTags.clear();
+    m_consumePaused = false;
+    m_consumerStats->bufferedMessages.set(0);
+    m_consumerStats->bufferedBytes.set(0);
+    m_consumerStats->unackedMessages.set(0);
+    m_consumerStats->unackedBytes.set(0);
+}
+
+bool QRabbitmqMgr::CloseMqConnection()
+{
+    if (!m_pConn) {
+        return true;
+    }
+
+    bool ret = true;
+    disconnect(m_pConn.get(), nullptr, this, nullptr);
+    if (m_mqInfo.shareConnection) {
+        // 共享连接由最后一个使用者关闭
+        QMqConnectionRegistry::Release(m_pConn, m_connChannels);
+    }
+    else if (!m_pConn->Close()) {
+        m_errMessag = m_pConn->getErrorMessage();
+        ret = false;
+    }
+    m_pConn = nullptr;
+
+    return ret;
+}
+
+int QRabbitmqMgr::ChannelsNeeded() const
+{
+    int channels = 1;
+    if (m_role & MqPublisher) {
+        channels += (m_mqInfo.enableBulkLane ? 1 : 0) + qMax(0, m_mqInfo.chunkChannels) + (m_mqInfo.txBatchMessages > 0 ? qMax(1, m_mqInfo.txChannels) : 0);
+    }
+    return channels;
+}
+
+MqMetricsSources QRabbitmqMgr::MetricsSources() const
+{
+    MqMetricsSources sources;
+    sources.conn = m_connStats;
+    sources.consumer = m_consumerStats;
+    sources.tx = m_txStats;
+    sources.replayed = m_replayed;
+    if (m_pArchiveWriter) {
+        sources.archive = m_pArchiveWriter->getSharedStats();
+    }
+    if (m_pTcpClient) {
+        sources.socket = m_pTcpClient->getSharedStats();
+    }
+    sources.dns = QMqDnsCache::instance()->getSharedStats();
+    return sources;
+}
+
+bool QRabbitmqMgr::CreateMqExchange(const QString &exchangeName, const QString &exchangeType)
+{
+    try {
+        if(exchangeName.isEmpty()) {
+            m_errMessag = "ExchangeName is empty.";
+            return false;
+        }
+
+        if(!MqExTypeMap.contains(exchangeType)) {
+            m_errMessag = "Create Exchange Failed, Unknow exType: " + exchangeType;
+            return false;
+        }
+
+        AMQP::ExchangeType type = MqExTypeMap[exchangeType];
+        m_channel->declareExchange(exchangeName.toStdString(), type, AMQP::durable).onError(this->Guarded(std::bind(&QRabbitmqMgr::CreatMqExchangeErrCb, this, std::placeholders::_1)));
+    }
+    catch (const std::exception &e)
+    {
+        m_errMessag = "Create Exchange Failed: " + QString(e.what());
+        return false;
+    }
+
+    return true;
+}
+
+bool QRabbitmqMgr::CreateMqQueue(const QString &queueName)
+{
+    try {
+        m_channel->declareQueue(queueName.toStdString(), AMQP::durable).onError(this->Guarded(std::bind(&QRabbitmqMgr::CreatMqQueueErrCb, this, std::placeholders::_1)));
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Create Queue Failed: " + QString(e.what());
+        return false;
+    }
+
+    return true;
+}
+
+bool QRabbitmqMgr::BindQueue(const QString &queueName, const QString &exchangeName, const QString &bindingKey)
+{
+    try {
+        if(exchangeName.isEmpty() || queueName.isEmpty()) {
+            m_errMessag = "ExchangeName or QueueName is empty.";
+            return false;
+        }
+
+        QString realBindKey = bindingKey.isEmpty()? queueName : bindingKey;
+        m_channel->bindQueue(exchangeName.toStdString(), queueName.toStdString(), realBindKey.toStdString())
+                .onError(this->Guarded(std::bind(&QRabbitmqMgr::BindQueueErrCb, this, std::placeholders::_1)));
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Bind Queue Failed: " + QString(e.what());
+        return false;
+    }
+
+    return true;
+}
+
+bool QRabbitmqMgr::SetQosValue(const uint16_t val)
+{
+    try{
+        m_channel->setQos(val).onError(this->Guarded(std::bind(&QRabbitmqMgr::SetQosValueErrCb, this, std::placeholders::_1)));
+    }
+    catch (const std::exception &e){
+        m_errMessag = "Set Qos Failed: " + QString(e.what());
+        return false;
+    }
+    return true;
+}
+
+bool QRabbitmqMgr::StartConsumeMsg()
+{
+    if(!(m_role & MqConsumer)) {
+        m_errMessag = "Consume Data Failed: MqRole is not Consumer";
+        return false;
+    }
+    if(m_channel == nullptr) {
+        m_errMessag = "Consume Data Failed: channel is null";
+        return false;
+    }
+
+    m_consumeStarted = true;
+    return this->ConsumeQueues();
+}
+
+uint16_t QRabbitmqMgr::PrefetchShare(int index) const
+{
+    int totalWeight = 0;
+    for (const MqQueueInfo &queue : m_consumeQueues) {
+        totalWeight += qMax(1, queue.weight);
+    }
+
+    int share = m_mqInfo.prefetchCount * qMax(1, m_consumeQueues[index].weight) / qMax(1, totalWeight);
+    return (uint16_t)qMax(1, share);
+}
+
+bool QRabbitmqMgr::ConsumeQueues()
+{
+    try {
+        for (int i = 0; i < m_consumeQueues.size(); i++) {
+            // 非global的qos只作用于之后创建的consumer，每个consumer前设置各自的预取数量
+            if (m_mqInfo.prefetchCount > 0 && !this->SetQosValue(this->PrefetchShare(i))) {
+                return false;
+            }
+
+            AMQP::DeferredConsumer &consumer = m_channel->consume(m_consumeQueues[i].queueName.toStdString());
+            consumer.onSuccess(this->Guarded([this](const std::string &consumerTag) { m_consumerTags.push_back(consumerTag); }));
+            if (m_consumeFilter) {
+                // 设置onReceived时AMQP-CPP总会组装body，过滤模式改为逐帧接收
+                consumer.onBegin(this->Guarded(std::bind(&QRabbitmqMgr::OnFilterBegin, this, std::placeholders::_1, std::placeholders::_2)))
+                        .onSize(this->Guarded([this](uint64_t size) { m_stagedSize = size; }))
+                        .onHeaders(this->Guarded(std::bind(&QRabbitmqMgr::OnFilterHeaders, this, std::placeholders::_1)))
+                        .onData(this->Guarded(std::bind(&QRabbitmqMgr::OnFilterData, this, std::placeholders::_1, std::placeholders::_2)))
+                        .onComplete(this->Guarded(std::bind(&QRabbitmqMgr::OnFilterComplete, this, std::placeholders::_1, std::placeholders::_2, i)));
+            }
+            else {
+                consumer.onReceived(this->Guarded([this, i](const AMQP::Message &message, uint64_t deliveryTag, bool redelivered) {
+                    this->OnConsumeRecved(message, deliveryTag, redelivered, i);
+                }));
+            }
+            consumer.onError(this->Guarded(std::bind(&QRabbitmqMgr::ConsumeErrorCb, this, std::placeholders::_1)));
+        }
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Consume Data Failed: " + QString(e.what());
+        return false;
+    }
+    return true;
+}
+
+void QRabbitmqMgr::setConsumeFilter(const MqConsumeFilter &filter)
+{
+    m_consumeFilter = filter;
+}
+
+void QRabbitmqMgr::setInlineHandler(const MqInlineHandler &handler)
+{
+    m_inlineHandler = handler;
+}
+
+void QRabbitmqMgr::OnFilterBegin(const std::string &exchange, const std::string &routingKey)
+{
+    m_stagedMessage = make_shared<MqStagedMessage>(exchange, routingKey);
+    m_stagedAccepted = true;
+    m_stagedSize = 0;
+}
+
+void QRabbitmqMgr::OnFilterHeaders(const AMQP::MetaData &meta)
+{
+    if (!m_stagedMessage) {
+        return;
+    }
+
+    m_stagedAccepted = m_consumeFilter(m_stagedMessage->exchange(), m_stagedMessage->routingkey(), meta);
+    if (m_stagedAccepted) {
+        m_stagedMessage->setMeta(meta, m_stagedSize);
+    }
+    else {
+        m_stagedMessage = nullptr;
+    }
+}
+
+void QRabbitmqMgr::OnFilterData(const char *data, size_t size)
+{
+    if (m_stagedMessage) {
+        m_stagedMessage->appendData(data, size);
+    }
+}
+
+void QRabbitmqMgr::OnFilterComplete(uint64_t deliveryTag, bool redelivered, int queueIndex)
+{
+    if (!m_stagedAccepted) {
+        m_channel->ack(deliveryTag);
+        m_consumerStats->filterDropped.add();
+        m_consumerStats->filterDroppedBytes.add(m_stagedSize);
+        return;
+    }
+    if (!m_stagedMessage) {
+        return;
+    }
+
+    // 单帧body引用的帧数据只在本次回调中有效，OnConsumeRecved内会拷贝
+    std::shared_ptr<MqStagedMessage> message = m_stagedMessage;
+    m_stagedMessage = nullptr;
+    m_consumerStats->filterPassed.add();
+    this->OnConsumeRecved(*message, deliveryTag, redelivered, queueIndex);
+}
+
+void QRabbitmqMgr::PauseDelivery()
+{
+    if (m_consumePaused || !m_channel) {
+        return;
+    }
+
+    try {
+        if (m_mqInfo.flowMode == MqFlowChannel) {
+            m_channel->pause().onError(this->Guarded(std::bind(&QRabbitmqMgr::ConsumeErrorCb, this, std::placeholders::_1)));
+        }
+        else if (!m_consumerTags.empty()) {
+            // 已预取的消息仍会到达并进入缓冲，之后不再有新投递
+            for (const std::string &consumerTag : m_consumerTags) {
+                m_channel->cancel(consumerTag);
+            }
+            m_consumerTags.clear();
+        }
+        else {
+            return;
+        }
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Pause Delivery Failed: " + QString(e.what());
+        this->OnPrintErrMsg(m_errMessag);
+        return;
+    }
+
+    m_consumePaused = true;
+    m_pauseClock.start();
+    m_consumerStats->pauseCount.add();
+}
+
+void QRabbitmqMgr::ResumeDelivery()
+{
+    if (!m_consumePaused || !m_channel) {
+        return;
+    }
+
+    m_consumePaused = false;
+    m_consumerStats->pausedMs.add(m_pauseClock.elapsed());
+
+    try {
+        if (m_mqInfo.flowMode == MqFlowChannel) {
+            m_channel->resume().onError(this->Guarded(std::bind(&QRabbitmqMgr::ConsumeErrorCb, this, std::placeholders::_1)));
+            return;
+        }
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Resume Delivery Failed: " + QString(e.what());
+        this->OnPrintErrMsg(m_errMessag);
+        return;
+    }
+
+    if (!this->ConsumeQueues()) {
+        this->OnPrintErrMsg(m_errMessag);
+    }
+}
+
+bool QRabbitmqMgr::AckMsg(uint64_t deliveryTag)
+{
+    if (m_channel == nullptr || !m_unackedDeliveries.contains(deliveryTag)) {
+        m_errMessag = "Ack Message Failed: unknown deliveryTag";
+        return false;
+    }
+
+    try {
+        m_channel->ack(BrokerTag(deliveryTag));
+        m_consumerStats->acked.add();
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Ack Message Failed: " + QString(e.what());
+        return false;
+    }
+
+    if (m_pDedupCache) {
+        m_pDedupCache->insert(m_unackedDeliveries.value(deliveryTag).dedupKey);
+    }
+    this->ReleaseUnacked(deliveryTag);
+    return true;
+}
+
+bool QRabbitmqMgr::RejectMsg(uint64_t deliveryTag, bool requeue)
+{
+    if (m_channel == nullptr || !m_unackedDeliveries.contains(deliveryTag)) {
+        m_errMessag = "Reject Message Failed: unknown deliveryTag";
+        return false;
+    }
+
+    if (requeue && m_mqInfo.retryMaxAttempts > 0) {
+        this->ScheduleRetry(deliveryTag);
+        return true;
+    }
+
+    try {
+        m_channel->reject(BrokerTag(deliveryTag), requeue ? AMQP::requeue : 0);
+        m_consumerStats->rejected.add();
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Reject Message Failed: " + QString(e.what());
+        return false;
+    }
+
+    this->ReleaseUnacked(deliveryTag);
+    return true;
+}
+
+void QRabbitmqMgr::ReleaseUnacked(uint64_t deliveryTag)
+{
+    MqDelivery delivery = m_unackedDeliveries.take(deliveryTag);
+    m_deliveryBuffer.removeUnacked(delivery.body.size());
+    if (m_retryWheel.cancel(deliveryTag)) {
+        m_retryHeld[delivery.queueIndex]--;
+        m_consumerStats->retryHeld.set(m_retryWheel.size());
+    }
+    m_retryAttempts.remove(deliveryTag);
+    m_consumerStats->unackedMessages.set(m_deliveryBuffer.unackedMessages());
+    m_consumerStats->unackedBytes.set(m_deliveryBuffer.unackedBytes());
+
+    if (m_consumePaused && m_deliveryBuffer.belowLowWatermark()) {
+        this->ResumeDelivery();
+    }
+}
+
+void QRabbitmqMgr::OnDispatchDeliveries()
+{
+    // 被替换的消息不再分发，每轮批量ack
+    if (!m_supersededTags.isEmpty() && m_channel) {
+        try {
+            for (uint64_t deliveryTag : m_supersededTags) {
+                m_channel->ack(BrokerTag(deliveryTag));
+            }
+            m_consumerStats->acked.add(m_supersededTags.size());
+        }
+        catch (const std::exception &e) {
+            m_errMessag = "Ack Message Failed: " + QString(e.what());
+            this->OnPrintErrMsg(m_errMessag);
+        }
+    }
+    m_supersededTags.clear();
+
+    // 过期消息不交给应用，本轮结束后批量处理
+    qint64 nowMs = m_mqInfo.expiryCheck ? QDateTime::currentMSecsSinceEpoch() : 0;
+    QList<MqDelivery> expired;
+    int count = 0;
+    while (!m_deliveryBuffer.isEmpty() && count < m_mqInfo.dispatchBatch) {
+        MqDelivery delivery = m_deliveryBuffer.pop();
+        if (m_mqInfo.expiryCheck && this->IsExpired(delivery.meta, delivery.receivedMs, nowMs)) {
+            expired.append(std::move(delivery));
+        }
+        else {
+            this->DispatchDelivery(delivery);
+        }
+        count++;
+    }
+    if (!expired.isEmpty()) {
+        this->DropExpired(expired);
+    }
+
+    m_consumerStats->bufferedMessages.set(m_deliveryBuffer.bufferedMessages());
+    m_consumerStats->bufferedBytes.set(m_deliveryBuffer.bufferedBytes());
+
+    // 剩余的消息留到下一次事件循环，避免长时间阻塞socket读取
+    if (!m_deliveryBuffer.isEmpty()) {
+        m_dispatchTimer.start(0);
+    }
+
+    if (m_consumePaused && m_deliveryBuffer.belowLowWatermark()) {
+        this->ResumeDelivery();
+    }
+}
+
+void QRabbitmqMgr::DispatchDelivery(const MqDelivery &delivery)
+{
+    if (!m_mqInfo.autoAck) {
+        this->TrackUnacked(delivery);
+    }
+
+    this->EmitDelivery(delivery);
+    // 本机其他进程只收首次分发，本地重试不再写入
+    if (m_pShmRing) {
+        m_pShmRing->Write(QByteArray::fromStdString(delivery.exchange), QByteArray::fromStdString(delivery.routingKey),
+                          delivery.body);
+    }
+
+    if (m_mqInfo.autoAck && m_channel) {
+        m_channel->ack(BrokerTag(delivery.deliveryTag));
+        m_consumerStats->acked.add();
+        if (m_pDedupCache) {
+            m_pDedupCache->insert(delivery.dedupKey);
+        }
+    }
+}
+
+bool QRabbitmqMgr::NeedsBuffering() const
+{
+    return m_mqInfo.bufferHighBytes > 0 || m_mqInfo.bufferHighMessages > 0
+            || m_consumeQueues.size() > 1 || m_mqInfo.priorityLevels > 1
+            || m_mqInfo.conflateDeliveries || m_mqInfo.expiryCheck;
+}
+
+bool QRabbitmqMgr::IsExpired(const AMQP::MetaData &meta, qint64 receivedMs, qint64 nowMs) const
+{
+    if (!m_mqInfo.deadlineHeader.isEmpty() && meta.hasHeaders()) {
+        const std::string name = m_mqInfo.deadlineHeader.toStdString();
+        if (meta.headers().contains(name)) {
+            const AMQP::Field &field = meta.headers().get(name);
+            qint64 deadlineMs = 0;
+            if (field.isInteger()) {
+                deadlineMs = (int64_t)field;
+            }
+            else if (field.isString()) {
+                deadlineMs = QString::fromStdString((const std::string &)field).toLongLong();
+            }
+            if (deadlineMs > 0) {
+                return nowMs >= deadlineMs;
+            }
+        }
+    }
+
+    // expiration是相对时间(毫秒)，有timestamp属性时从发送时起算
+    if (meta.hasExpiration()) {
+        bool ok = false;
+        qint64 ttlMs = QString::fromStdString(meta.expiration()).toLongLong(&ok);
+        if (ok) {
+            qint64 startMs = meta.hasTimestamp() ? (qint64)meta.timestamp() * 1000 : receivedMs;
+            return nowMs >= startMs + ttlMs;
+        }
+    }
+    return false;
+}
+
+void QRabbitmqMgr::DropExpired(const QList<MqDelivery> &expired)
+{
+    if (m_channel == nullptr) {
+        return;
+    }
+
+    // 转发和ack在本轮事件循环中一起发出
+    bool deadLetter = m_mqInfo.expiredDeadLetter;
+    try {
+        for (const MqDelivery &delivery : expired) {
+            if (deadLetter && !m_mqInfo.deadLetterExchange.isEmpty()) {
+                AMQP::Envelope envelope(delivery.meta, delivery.body.constData(), delivery.body.size());
+                m_channel->publish(m_mqInfo.deadLetterExchange.toStdString(), delivery.routingKey, envelope);
+                m_channel->ack(BrokerTag(delivery.deliveryTag));
+            }
+            else if (deadLetter) {
+                m_channel->reject(BrokerTag(delivery.deliveryTag));
+            }
+            else {
+                m_channel->ack(BrokerTag(delivery.deliveryTag));
+            }
+            m_consumerStats->expired.add();
+            m_consumerStats->expiredBytes.add(delivery.body.size());
+        }
+        if (deadLetter) {
+            m_consumerStats->deadLettered.add(expired.size());
+        }
+        else {
+            m_consumerStats->acked.add(expired.size());
+        }
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Drop Expired Message Failed: " + QString(e.what());
+        this->OnPrintErrMsg(m_errMessag);
+    }
+}
+
+MqDelivery QRabbitmqMgr::MakeDelivery(const AMQP::Message &message, uint64_t deliveryTag, bool redelivered, int queueIndex) const
+{
+    MqDelivery delivery;
+    delivery.body = QByteArray(message.body(), message.bodySize());
+    delivery.exchange = message.exchange();
+    delivery.routingKey = message.routingkey();
+    delivery.meta = message;
+    delivery.deliveryTag = this->AppTag(deliveryTag);
+    delivery.redelivered = redelivered;
+    delivery.queueIndex = queueIndex;
+    return delivery;
+}
+
+void QRabbitmqMgr::TrackUnacked(const MqDelivery &delivery)
+{
+    m_unackedDeliveries.insert(delivery.deliveryTag, delivery);
+    m_deliveryBuffer.addUnacked(delivery.body.size());
+    m_consumerStats->unackedMessages.set(m_deliveryBuffer.unackedMessages());
+    m_consumerStats->unackedBytes.set(m_deliveryBuffer.unackedBytes());
+}
+
+void QRabbitmqMgr::ApplyInlineResult(MqInlineResult result, const MqDelivery &delivery)
+{
+    if (result == MqInlineAck) {
+        m_consumerStats->inlineHandled.add();
+        if (!m_mqInfo.autoAck) {
+            this->AckMsg(delivery.deliveryTag);
+            return;
+        }
+        // 自动ack的消息broker已确认，只记录去重并释放本地状态
+        if (m_pDedupCache) {
+            m_pDedupCache->insert(delivery.dedupKey);
+        }
+        this->ReleaseUnacked(delivery.deliveryTag);
+    }
+    else if (result == MqInlineReject) {
+        m_consumerStats->inlineHandled.add();
+        this->RejectMsg(delivery.deliveryTag, true);
+    }
+    else {
+        this->EmitDelivery(delivery);
+        // 自动ack时应用不会再确认这条消息，分发后即释放
+        if (m_mqInfo.autoAck) {
+            this->ReleaseUnacked(delivery.deliveryTag);
+        }
+    }
+}
+
+void QRabbitmqMgr::EmitDelivery(const MqDelivery &delivery)
+{
+    m_consumerStats->dispatched.add();
+    emit sigRecvedDataReady(delivery.body);
+    emit sigRecvedDelivery(delivery.body, delivery.deliveryTag, delivery.redelivered);
+    if (delivery.queueIndex >= 0 && delivery.queueIndex < m_consumeQueues.size()) {
+        emit sigRecvedQueueMsg(m_consumeQueues[delivery.queueIndex].queueName, delivery.body, delivery.deliveryTag);
+    }
+}
+
+void QRabbitmqMgr::ScheduleRetry(uint64_t deliveryTag)
+{
+    int attempt = m_retryAttempts.value(deliveryTag, 0) + 1;
+    if (attempt > m_mqInfo.retryMaxAttempts) {
+        this->DeadLetterMsg(deliveryTag);
+        return;
+    }
+
+    // 等待重试的消息一直占用所在队列的预取份额，留出余量给新消息
+    int queueIndex = m_unackedDeliveries.value(deliveryTag).queueIndex;
+    int prefetch = (m_mqInfo.prefetchCount > 0 && queueIndex < m_consumeQueues.size()) ? this->PrefetchShare(queueIndex) : 0;
+    int maxHeld = m_mqInfo.retryMaxHeld;
+    if (maxHeld <= 0 && prefetch > 0) {
+        maxHeld = qMax(1, prefetch / 2);
+    }
+    if (prefetch > 0) {
+        maxHeld = qMin(maxHeld, qMax(1, prefetch - 1));
+    }
+    if (maxHeld > 0 && m_retryHeld.value(queueIndex, 0) >= maxHeld) {
+        try {
+            if (!m_mqInfo.autoAck) {
+                m_channel->reject(BrokerTag(deliveryTag), AMQP::requeue);
+            }
+            m_consumerStats->rejected.add();
+        }
+        catch (const std::exception &e) {
+            m_errMessag = "Reject Message Failed: " + QString(e.what());
+            this->OnPrintErrMsg(m_errMessag);
+        }
+        this->ReleaseUnacked(deliveryTag);
+        return;
+    }
+
+    qint64 delay = (qint64)m_mqInfo.retryBaseDelayMs << qMin(attempt - 1, 30);
+    delay = qMin<qint64>(delay, m_mqInfo.retryMaxDelayMs);
+
+    // 定时器只在到期时唤醒，时间轮的当前tick可能落后，先推进到当前时间再按延迟添加
+    QList<uint64_t> expired = m_retryWheel.advance(m_retryClock.elapsed());
+    m_retryWheel.schedule(deliveryTag, delay);
+    m_retryAttempts.insert(deliveryTag, attempt);
+    m_retryHeld[queueIndex]++;
+    m_consumerStats->retryHeld.set(m_retryWheel.size());
+    this->ArmRetryTimer();
+    this->RetryExpired(expired);
+}
+
+void QRabbitmqMgr::ArmRetryTimer()
+{
+    // 只在最近的到期时间唤醒，不按tick空转
+    qint64 nextMs = m_retryWheel.nextExpireMs();
+    if (nextMs < 0) {
+        m_retryTimer.stop();
+        return;
+    }
+    m_retryTimer.start((int)qBound<qint64>(0, nextMs - m_retryClock.elapsed(), INT_MAX));
+}
+
+void QRabbitmqMgr::DeadLetterMsg(uint64_t deliveryTag)
+{
+    const MqDelivery delivery = m_unackedDeliveries.value(deliveryTag);
+
+    try {
+        if (!m_mqInfo.deadLetterExchange.isEmpty()) {
+            AMQP::Envelope envelope(delivery.meta, delivery.body.constData(), delivery.body.size());
+            m_channel->publish(m_mqInfo.deadLetterExchange.toStdString(), delivery.routingKey, envelope);
+            if (!m_mqInfo.autoAck) {
+                m_channel->ack(BrokerTag(deliveryTag));
+            }
+        }
+        else if (!m_mqInfo.autoAck) {
+            m_channel->reject(BrokerTag(deliveryTag));
+        }
+        m_consumerStats->deadLettered.add();
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Dead Letter Message Failed: " + QString(e.what());
+        this->OnPrintErrMsg(m_errMessag);
+    }
+
+    this->ReleaseUnacked(deliveryTag);
+}
+
+void QRabbitmqMgr::OnRetryTick()
+{
+    QList<uint64_t> expired = m_retryWheel.advance(m_retryClock.elapsed());
+    m_consumerStats->retryHeld.set(m_retryWheel.size());
+    this->ArmRetryTimer();
+    this->RetryExpired(expired);
+}
+
+void QRabbitmqMgr::RetryExpired(const QList<uint64_t> &expired)
+{
+    for (uint64_t deliveryTag : expired) {
+        if (!m_unackedDeliveries.contains(deliveryTag)) {
+            continue;
+        }
+        MqDelivery delivery = m_unackedDeliveries.value(deliveryTag);
+        m_retryHeld[delivery.queueIndex]--;
+        delivery.redelivered = true;
+        m_consumerStats->retried.add();
+        if (delivery.inlineRetry && m_inlineHandler) {
+            // 按原有方式重新组装消息，body只有一段时直接引用，不再拷贝
+            MqStagedMessage message(delivery.exchange, delivery.routingKey);
+            message.setMeta(delivery.meta, delivery.body.size());
+            message.appendData(delivery.body.constData(), delivery.body.size());
+            this->ApplyInlineResult(m_inlineHandler(message, deliveryTag, true, delivery.queueIndex), delivery);
+            continue;
+        }
+        this->EmitDelivery(delivery);
+    }
+}
+
+bool QRabbitmqMgr::PurgeMsgQueue()
+{
+    try {
+        QMutexLocker channelLocker(&m_channelMutex);
+        if (m_channel && m_channel->usable()) {
+            m_channel->purgeQueue(m_mqInfo.queueName.toStdString());
+        }
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Purge Queue Failed: " + QString(e.what());
+        return false;
+    }
+
+    return true;
+}
+
+void QRabbitmqMgr::ChannelOkCb()
+{
+    this->BindQueueExchange();
+    this->OnStatusChange(true);
+
+    // 重建的channel上重新设置qos并consume
+    if (m_consumeOnReady) {
+        m_consumeOnReady = false;
+        if (!this->ConsumeQueues()) {
+            this->OnPrintErrMsg(m_errMessag);
+        }
+    }
+}
+
+void QRabbitmqMgr::ChannelErrCb(const char *msg, int slot)
+{
+    m_errMessag = "Channel Error: " + QString(msg);
+    this->OnChannelError(slot);
+}
+
+void QRabbitmqMgr::TxChannelErrCb(const char *msg, int index)
+{
+    // 未提交的消息随channel一起丢弃，已发出的commit由各自的onError通知
+    if (index == m_txCurrent && m_txBatchMessages > 0) {
+        m_txLingerTimer.stop();
+        int messages = m_txBatchMessages;
+        m_txBatchMessages = 0;
+        m_txBatchBytes = 0;
+        this->FailTxBatch(m_txBatchId++, messages, "Channel Error: " + QString(msg));
+    }
+    // 之后的批次先用其他tx channel，出错的channel重建后再轮到
+    if (index == m_txCurrent) {
+        m_txCurrent = (m_txCurrent + 1) % (int)m_txChannels.size();
+    }
+
+    this->ChannelErrCb(msg, MqTxChannel - index);
+}
+
+void QRabbitmqMgr::TxCommitOkCb(quint64 batchId, int messages, qint64 startUs)
+{
+    m_txStats->inFlightCommits.sub();
+    m_txStats->commitLatency.record((uint64_t)qMax<qint64>(0, m_txClock.nsecsElapsed() / 1000 - startUs));
+    m_txStats->committedBatches.add();
+    m_txStats->committedMessages.add(messages);
+    emit sigTxBatchFinished(batchId, messages, true, QString());
+}
+
+void QRabbitmqMgr::TxCommitErrCb(const char *msg, quint64 batchId, int messages)
+{
+    m_txStats->inFlightCommits.sub();
+    this->FailTxBatch(batchId, messages, "Commit Transaction Failed: " + QString(msg));
+}
+
+void QRabbitmqMgr::OnChannelError(int slot)
+{
+    // 连接不可用或未开启恢复时维持原处理：关闭channel，由应用重启实例
+    if (m_mqInfo.channelRecoveryMax <= 0 || m_role == MqNone || !m_connection || !m_connection->usable()) {
+        this->OnStatusChange(false);
+        return;
+    }
+
+    // 一次channel错误会触发channel和各个未完成操作的onError，只重建一次
+    if (m_recoverSlots.contains(slot)) {
+        return;
+    }
+    // 稳定运行一段时间后重新计数
+    if (m_recoverClock.isValid() && m_recoverClock.elapsed() > 30 * 1000) {
+        m_channelRecoveries = 0;
+    }
+    if (m_channelRecoveries >= m_mqInfo.channelRecoveryMax) {
+        this->OnStatusChange(false);
+        return;
+    }
+
+    this->OnPrintErrMsg(m_errMessag);
+    m_recoverSlots.insert(slot);
+    if (!m_recoverTimer.isActive()) {
+        // 不在AMQP回调中销毁channel，放到下一次事件循环
+        m_recoverTimer.start(m_mqInfo.channelRecoveryDelayMs << qMin(m_channelRecoveries, 10));
+    }
+}
+
+void QRabbitmqMgr::OnRecoverChannels()
+{
+    QSet<int> recoverSlots = m_recoverSlots;
+    m_recoverSlots.clear();
+    m_channelRecoveries++;
+    m_recoverClock.start();
+
+    try {
+        QMutexLocker channelLocker(&m_channelMutex);
+        for (int slot : recoverSlots) {
+            if (slot == MqMainChannel) {
+                // 旧channel上的deliveryTag全部失效，换代后旧tag不会误ack新channel的消息
+                this->ResetConsumeState();
+                m_channelGeneration++;
+                m_consumeOnReady = m_consumeStarted && (m_role & MqConsumer);
+                m_channel = std::make_shared<AMQP::Channel>(m_connection.get());
+                m_channel->onReady(this->Guarded(std::bind(&QRabbitmqMgr::ChannelOkCb, this)));
+                m_channel->onError(this->Guarded(std::bind(&QRabbitmqMgr::ChannelErrCb, this, std::placeholders::_1, MqMainChannel)));
+                continue;
+            }
+            if (slot <= MqTxChannel) {
+                m_txChannels[MqTxChannel - slot] = this->CreateTxChannel(MqTxChannel - slot);
+                continue;
+            }
+
+            std::shared_ptr<AMQP::Channel> &channel = (slot == MqBulkChannel) ? m_bulkChannel : m_chunkChannels[slot];
+            if (channel && m_pHandler) {
+                m_pHandler->setChannelLane(channel->id(), MqLaneControl);
+            }
+            channel = this->CreateLaneChannel(slot);
+        }
+        m_consumerStats->channelRecoveries.add();
+    }
+    catch (const std::exception &e) {
+        m_errMessag = "Recover Channel Failed: " + QString(e.what());
+        this->OnStatusChange(false);
+    }
+}
+
+bool QRabbitmqMgr::CanSendEncoded(const std::shared_ptr<AMQP::Channel> &channel)
+{
+    // Channel::waiting()是对AMQP-CPP头文件的本地修改，见AmpqCpp/LOCAL_PATCHES.md
+    return channel->ready() && !channel->waiting();
+}
+
+uint64_t QRabbitmqMgr::AppTag(uint64_t brokerTag) const
+{
+    return (m_channelGeneration << MqTagGenerationShift) | (brokerTag & MqBrokerTagMask);
+}
+
+uint64_t QRabbitmqMgr::BrokerTag(uint64_t appTag)
+{
+    return appTag & MqBrokerTagMask;
 }
 
 void QRabbitmqMgr::ChannelCloseErrCb(const char *msg)
@@ -389,42 +1828,161 @@ void QRabbitmqMgr::ChannelCloseErrCb(const char *msg)
 void QRabbitmqMgr::CreatMqExchangeErrCb(const char *msg)
 {
     m_errMessag = "Create Exchange Failed: " + QString(msg);
-    this->OnStatusChange(false);
+    this->OnChannelError(MqMainChannel);
 }
 
 void QRabbitmqMgr::CreatMqQueueErrCb(const char *msg)
 {
     m_errMessag = "Create Queue Failed: " + QString(msg);
-    this->OnStatusChange(false);
+    this->OnChannelError(MqMainChannel);
 }
 
 void QRabbitmqMgr::BindQueueErrCb(const char *msg)
 {
     m_errMessag = "Bind Queue Failed: " + QString(msg);
-    this->OnStatusChange(false);
+    this->OnChannelError(MqMainChannel);
 }
 
 void QRabbitmqMgr::SetQosValueErrCb(const char *msg)
 {
     m_errMessag = "Set Qos Failed: " + QString(msg);
-    this->OnStatusChange(false);
+    this->OnChannelError(MqMainChannel);
 }
 
 void QRabbitmqMgr::ConsumeErrorCb(const char *msg)
 {
     m_errMessag = "Consume Data Failed: " + QString(msg);
-    this->OnStatusChange(false);
+    this->OnChannelError(MqMainChannel);
 }
 
-void QRabbitmqMgr::OnConsumeRecved(const AMQP::Message &message, uint64_t deliveryTag, bool redelivered)
+void QRabbitmqMgr::OnConsumeRecved(const AMQP::Message &message, uint64_t deliveryTag, bool redelivered, int queueIndex)
 {
-    Q_UNUSED(redelivered)
-    QByteArray tmpData(message.body(), message.bodySize());
-    emit sigRecvedDataReady(tmpData);
-    //qDebug() << __FUNCTION__ << tmpData;
+    // 录制在其他处理之前，分片消息同样原样录制
+    if (m_pArchiveWriter && !m_pArchiveWriter->Append(message, redelivered)) {
+        this->OnPrintErrMsg(m_pArchiveWriter->getErrorMessage());
+    }
 
-    // acknowledge the message
-    m_channel->ack(deliveryTag);
+    // 分片消息交给重组对象，写入成功后再ack，校验失败的分片丢弃，由发送端补发
+    MqChunkInfo chunk;
+    if (m_pChunkAssembler && QMqChunkAssembler::ParseChunkHeaders(message, chunk)) {
+        if (m_pChunkAssembler->AppendChunk(chunk, message.body(), message.bodySize())) {
+            m_channel->ack(deliveryTag);
+        }
+        else {
+            this->OnPrintErrMsg(m_pChunkAssembler->getErrorMessage());
+            m_channel->reject(deliveryTag);
+        }
+        return;
+    }
+
+    // 处理过的消息(常见于重连或消费者崩溃后的重新投递)直接ack，不再拷贝和分发
+    uint64_t dedupKey = m_pDedupCache ? QMqDedupCache::MakeKey(message, message.body(), message.bodySize()) : 0;
+    if (dedupKey != 0 && (redelivered || !m_mqInfo.dedupRedeliveredOnly)) {
+        m_consumerStats->dedupChecked.add();
+        if (m_pDedupCache->contains(dedupKey)) {
+            m_channel->ack(deliveryTag);
+            m_consumerStats->dedupDropped.add();
+            return;
+        }
+    }
+
+    m_consumerStats->received.add();
+    qint64 receivedMs = m_mqInfo.expiryCheck ? QDateTime::currentMSecsSinceEpoch() : 0;
+    if (m_inlineHandler) {
+        // 内联处理前同样检查截止时间
+        if (m_mqInfo.expiryCheck && this->IsExpired(message, receivedMs, receivedMs)) {
+            MqDelivery delivery;
+            delivery.body = QByteArray::fromRawData(message.body(), message.bodySize());
+            delivery.routingKey = message.routingkey();
+            delivery.meta = message;
+            delivery.deliveryTag = this->AppTag(deliveryTag);
+            this->DropExpired({ delivery });
+            return;
+        }
+        MqInlineResult result = m_inlineHandler(message, this->AppTag(deliveryTag), redelivered, queueIndex);
+        if (result != MqInlineDefer && m_pShmRing) {
+            // 内联处理的消息不经过DispatchDelivery，在这里写入共享内存环
+            m_pShmRing->Write(QByteArray::fromStdString(message.exchange()), QByteArray::fromStdString(message.routingkey()),
+                              QByteArray::fromRawData(message.body(), (int)message.bodySize()));
+        }
+        if (result == MqInlineAck) {
+            m_channel->ack(deliveryTag);
+            m_consumerStats->acked.add();
+            m_consumerStats->inlineHandled.add();
+            if (m_pDedupCache) {
+                m_pDedupCache->insert(dedupKey);
+            }
+            return;
+        }
+        if (result == MqInlineReject) {
+            m_consumerStats->inlineHandled.add();
+            // 启用本地重试时与缓冲分发一致，进入重试时间轮，避免broker立即重新投递形成循环
+            if (m_mqInfo.retryMaxAttempts > 0) {
+                MqDelivery delivery = this->MakeDelivery(message, deliveryTag, redelivered, queueIndex);
+                delivery.dedupKey = dedupKey;
+                delivery.inlineRetry = true;
+                this->TrackUnacked(delivery);
+                this->ScheduleRetry(delivery.deliveryTag);
+                return;
+            }
+            if (!m_mqInfo.autoAck) {
+                m_channel->reject(deliveryTag, AMQP::requeue);
+            }
+            m_consumerStats->rejected.add();
+            return;
+        }
+    }
+
+    // 不需要缓冲时直接分发，不经过0ms定时器；自动ack时消息分发后不再使用，不拷贝属性
+    if (!this->NeedsBuffering() && m_deliveryBuffer.isEmpty()) {
+        MqDelivery delivery;
+        if (m_mqInfo.autoAck) {
+            delivery.body = QByteArray(message.body(), message.bodySize());
+            if (m_pShmRing) {
+                delivery.exchange = message.exchange();
+                delivery.routingKey = message.routingkey();
+            }
+            delivery.deliveryTag = this->AppTag(deliveryTag);
+            delivery.redelivered = redelivered;
+            delivery.queueIndex = queueIndex;
+        }
+        else {
+            delivery = this->MakeDelivery(message, deliveryTag, redelivered, queueIndex);
+        }
+        delivery.dedupKey = dedupKey;
+        this->DispatchDelivery(delivery);
+        return;
+    }
+
+    MqDelivery delivery = this->MakeDelivery(message, deliveryTag, redelivered, queueIndex);
+    delivery.dedupKey = dedupKey;
+    delivery.receivedMs = receivedMs;
+
+    if (m_mqInfo.conflateDeliveries) {
+        std::string key;
+        if (!m_mqInfo.conflationKeyHeader.isEmpty() && message.headers().contains(m_mqInfo.conflationKeyHeader.toStdString())) {
+            key = (std::string)message.headers().get(m_mqInfo.conflationKeyHeader.toStdString());
+        }
+        delivery.conflationKey = QString::fromStdString(key.empty() ? delivery.routingKey : key);
+
+        uint64_t supersededTag = 0;
+        if (m_deliveryBuffer.pushConflated(std::move(delivery), supersededTag)) {
+            m_supersededTags.append(supersededTag);
+            m_consumerStats->conflated.add();
+        }
+    }
+    else {
+        m_deliveryBuffer.push(std::move(delivery));
+    }
+    m_consumerStats->bufferedMessages.set(m_deliveryBuffer.bufferedMessages());
+    m_consumerStats->bufferedBytes.set(m_deliveryBuffer.bufferedBytes());
+
+    if (m_deliveryBuffer.aboveHighWatermark()) {
+        this->PauseDelivery();
+    }
+    if (!m_dispatchTimer.isActive()) {
+        m_dispatchTimer.start(0);
+    }
 }
 
 
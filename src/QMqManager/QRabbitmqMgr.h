@@ -2,23 +2,77 @@
 #define QRABBITMQMGR_H
 
 #include <QMap>
+#include <QQueue>
 #include <QObject>
 #include <QTimer>
 #include <QMutex>
+#include <QHash>
+#include <QSet>
+#include <QElapsedTimer>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
 #include "amqpcpp/exchangetype.h"
 #include "QTcpClient.h"
+#include "QMqChunkAssembler.h"
+#include "QMqDeliveryBuffer.h"
+#include "QMqTimerWheel.h"
+#include "QMqShmRing.h"
+#include "QMqConnection.h"
+#include "QMqArchive.h"
+#include "QMqDedupCache.h"
+#include "QMqPublisher.h"
+#include "QMqMetricsExporter.h"
 
 
 namespace AMQP {
 class Connection;
 class Channel;
 class Message;
+class Envelope;
+class MetaData;
 }
 
 
 namespace AMQP_QT {
 
 class QTcpConnectionHandler;
+class MqStagedMessage;
+
+// 本地缓冲超过高水位时暂停投递的方式
+enum MqFlowMode {
+    MqFlowCancel = 0,   // 取消consumer，低于低水位时重新consume(RabbitMQ不支持channel.flow)
+    MqFlowChannel = 1   // 使用channel.flow暂停/恢复
+};
+
+// 消费过滤：收到内容头时调用，返回false的消息不接收body
+typedef std::function<bool(const std::string &exchange, const std::string &routingKey, const AMQP::MetaData &meta)> MqConsumeFilter;
+
+// 内联处理函数的处理结果
+enum MqInlineResult {
+    MqInlineAck = 0,    // 处理完成，立即ack
+    MqInlineReject = 1, // 处理失败，reject并requeue
+    MqInlineDefer = 2   // 不在此处理，按原流程拷贝进本地缓冲并通过信号分发
+};
+
+// 内联处理：在AMQP回调中直接调用，message的body、属性、routingKey均引用接收缓冲，只在调用期间有效
+typedef std::function<MqInlineResult(const AMQP::Message &message, uint64_t deliveryTag, bool redelivered, int queueIndex)> MqInlineHandler;
+
+// 发布目标
+typedef struct _mqpublishtarget
+{
+    QString exchangeName = "";
+    QString routingKey = "";
+} MqPublishTarget;
+
+// 多队列消费时每个队列的配置
+typedef struct _mqqueueinfo
+{
+    QString queueName = "";
+    QString bindingKey = "";    // 为空时使用queueName
+    int weight = 1;             // 调度权重，同时按权重分配预取数量；严格优先级模式下越大越优先
+} MqQueueInfo;
 
 typedef struct _mqinfo
 {
@@ -32,6 +86,55 @@ typedef struct _mqinfo
     QString vhost = "/";
     QString routingKey = ""; // 用于发送端发布消息
     QString bindingKey = ""; // 接收端绑定queue时使用
+    bool enableBulkLane = false; // 发送端启用独立的bulk通道，大消息不阻塞控制消息
+    uint32_t chunkSize = 1024 * 1024; // 分片发送时每片的大小
+    int chunkChannels = 0;      // 分片并行发送使用的channel数，0表示不启用分片发送
+    qint64 chunkMaxQueuedBytes = 8 * 1024 * 1024; // 分片发送时bulk通道排队数据的上限，超过后等socket写出再继续
+    bool enableChunkAssemble = false; // 接收端重组分片消息
+    QString chunkOutputDir = "";      // 分片重组输出目录，为空时在内存中重组
+    int chunkTimeoutMs = 60 * 1000;   // 分片传输超时时间
+    qint64 chunkMaxTotalBytes = 1024LL * 1024 * 1024; // 接收端单个传输的大小上限，内存模式下另受QByteArray上限约束
+    uint16_t prefetchCount = 0; // 消费端预取数量，0表示不限制
+    bool autoAck = true;        // 分发后自动ack，false时需调用AckMsg/RejectMsg
+    qint64 bufferHighBytes = 0; // 本地缓冲高水位(字节)，0表示不限制
+    qint64 bufferLowBytes = 0;  // 本地缓冲低水位(字节)
+    int bufferHighMessages = 0; // 本地缓冲高水位(消息数)，0表示不限制
+    int bufferLowMessages = 0;  // 本地缓冲低水位(消息数)
+    int dispatchBatch = 64;     // 每次事件循环最多分发的消息数
+    MqFlowMode flowMode = MqFlowCancel;
+    int retryMaxAttempts = 0;   // 处理失败的消息本地延迟重试次数，0表示不启用(RejectMsg直接requeue)
+    int retryBaseDelayMs = 1000;     // 首次重试的延迟，之后按2的幂退避
+    int retryMaxDelayMs = 60 * 1000; // 重试延迟上限
+    int retryMaxHeld = 0;       // 每个队列同时等待重试的消息上限，0表示取该队列预取份额的一半
+    QString deadLetterExchange = ""; // 重试耗尽后转发的exchange，为空时reject(不requeue)交给队列配置的DLX
+    QList<MqQueueInfo> consumeQueues;    // 同一连接、同一channel上消费多个队列，为空时只消费queueName
+    MqSchedulePolicy schedulePolicy = MqScheduleWeighted; // 多队列时的本地分发策略
+    int priorityLevels = 0;     // 本地缓冲按消息priority属性分级先分发高优先级(同级先进先出)，0表示按到达顺序
+    QString shmFanoutKey = "";  // 非空时把分发的消息同时写入该key的共享内存环，供本机其他进程用QMqShmRing读取
+    qint64 shmFanoutBytes = 64 * 1024 * 1024; // 共享内存环数据区大小
+    MqShmOverrunPolicy shmOverrunPolicy = MqShmOverwrite;
+    bool shareConnection = false;   // 同一线程内endpoint、vhost、登录信息相同的实例共享tcp连接，各自使用独立channel
+    int maxChannelsPerConnection = 64; // 共享连接时每个连接上的channel上限，超过时新建连接，0表示不限制
+    MqTlsConfig tls;            // amqps连接(端口通常为5671)，重连时恢复TLS会话
+    bool conflateDeliveries = false;  // 本地缓冲只保留同key的最新消息，被替换的消息直接ack
+    QString conflationKeyHeader = ""; // 合并key所在的header，为空或消息不带该header时使用routingKey
+    int channelRecoveryMax = 0;       // channel级错误时在原连接上重建channel的连续次数上限，0表示不恢复(出错即关闭)
+    int channelRecoveryDelayMs = 200; // 重建channel前的等待时间，连续失败时按2的幂退避
+    int txBatchMessages = 0;    // 事务发布时每批的消息数上限，0表示不启用事务发布
+    qint64 txBatchBytes = 0;    // 事务发布时每批的字节数上限，0表示不限制
+    int txLingerMs = 20;        // 批次中第一条消息最多等待多久即提交
+    int txChannels = 2;         // 轮流使用的tx channel数，一批在commit时下一批在另一条channel上发布；
+                                // 不同批次的消息在broker端可能交错，设为1时严格按批次顺序，但同时只有一个commit在途
+    QString archiveDir = "";    // 非空时把收到的每条消息(属性+body)录制到该目录，可用StartReplay回放
+    qint64 archiveSegmentBytes = 256 * 1024 * 1024; // 录制日志每段的大小
+    bool dedupEnabled = false;  // 去重：ack过的消息记录messageID(没有时用body哈希)，再次收到时直接ack不再分发
+    bool dedupRedeliveredOnly = true; // 只检查带redelivered标记的消息
+    int dedupWindow = 100000;   // 记录最近处理过的消息数
+    QString dedupPersistFile = ""; // 非空时去重窗口映射到该文件，进程重启后仍有效
+    QString metricsName = "";   // 非空时以该名称登记到进程内的指标表，由QMqMetricsExporter导出，不能与其他实例重名
+    bool expiryCheck = false;   // 分发前检查过期：expiration属性(从timestamp属性或收到时起算)或deadlineHeader
+    QString deadlineHeader = ""; // 截止时间所在的header(毫秒时间戳)，为空时只看expiration属性
+    bool expiredDeadLetter = false; // 过期消息转发到deadLetterExchange(为空时reject交给队列配置的DLX)，否则直接ack
 } MqInfo;
 
 // 定义exchangeType对应关系
@@ -63,15 +166,70 @@ public:
     ~QRabbitmqMgr();
 
     // 初始化时调用，启动连接、建立通道、创建组件并开启消费
+    // 构造时按MqInfo启用的功能(分片重组、去重持久化、归档、共享内存分发)初始化失败时返回false
     bool StartMqInstance();
     // 发送消息时调用。特别注意：该函数非线程安全，需要确保在单一线程中调用
     bool PublishMsg(const QString &msg);
+    // 按lane发送二进制数据，bulk lane需开启enableBulkLane，否则退化为控制通道
+    bool PublishData(const QByteArray &data, MqLane lane = MqLaneControl);
+    // 大消息分片后在多个channel上并行发送。transferId为空时自动生成；
+    // chunks指定需要(补)发的分片序号，为空时发送全部分片。分片按发送队列的余量逐片发出，
+    // 返回true只表示已排队，全部分片发出后(或失败时)发出sigChunkedFinished；data在此期间与调用方共享不拷贝
+    bool PublishChunked(const QByteArray &data, QString &transferId, const QList<uint32_t> &chunks = QList<uint32_t>());
+    // 同一内容发往多个exchange/routingKey，内容头和body只编码一次，每个目标只新增一个方法帧
+    bool PublishMany(const AMQP::Envelope &envelope, const QList<MqPublishTarget> &targets, MqLane lane = MqLaneControl);
+    bool PublishMany(const QByteArray &data, const QList<MqPublishTarget> &targets, MqLane lane = MqLaneControl);
+    // 合并发送：同key的消息还在发送队列中时被新消息原位替换，适合只关心最新值的数据
+    bool PublishConflated(const QString &key, const AMQP::Envelope &envelope, MqLane lane = MqLaneControl);
+    bool PublishConflated(const QString &key, const QByteArray &data, MqLane lane = MqLaneControl);
+    // 创建绑定exchange、routingKey、flags和默认属性的发布句柄，之后每条消息只需给出body
+    std::shared_ptr<QMqPublisher> CreatePublisher(const QString &exchangeName, const QString &routingKey, int flags = 0,
+                                                  const AMQP::MetaData &defaults = AMQP::MetaData(),
+                                                  MqLane lane = MqLaneControl);
+    // 用句柄缓存的帧发布，overrides非空时替代默认属性
+    bool PublishBound(QMqPublisher &publisher, const QByteArray &body, const AMQP::MetaData *overrides = nullptr);
+    // 事务发布：消息在独立的tx channel上按批提交，各批轮流使用txChannels条channel，
+    // batchId返回所属批次，结果通过sigTxBatchFinished通知
+    bool PublishTransacted(const QByteArray &data, quint64 &batchId);
+    // 立即提交当前批次，不等待数量、字节或时间上限
+    bool CommitTxBatch();
+    // 把录制的消息按原有exchange/routingKey重新发布，按config控制节奏，完成后发出sigReplayFinished
+    bool StartReplay(const QString &archiveDir, const MqReplayConfig &config = MqReplayConfig());
+    void StopReplay();
+    // 设置消费过滤，在StartConsumeMsg之前调用。被过滤的消息直接ack，不拷贝body也不进入本地缓冲
+    void setConsumeFilter(const MqConsumeFilter &filter);
+    // 设置内联处理函数，消息不拷贝、不经过信号直接交给它处理；
+    // 先于本地缓冲中尚未分发的消息执行，需要保序时不要与信号分发混用。
+    // 返回reject且启用本地重试时，消息拷贝后进入重试时间轮，到期后再次交给内联处理函数
+    void setInlineHandler(const MqInlineHandler &handler);
     // 开始消费数据
     bool StartConsumeMsg();
     // 清空消息队列，需保证queue已创建好
     bool PurgeMsgQueue();
+    // 手动ack模式下，处理完消息后调用
+    bool AckMsg(uint64_t deliveryTag);
+    // 手动ack模式下，处理失败时调用。启用本地重试时requeue的消息不回broker，退避后重新分发
+    bool RejectMsg(uint64_t deliveryTag, bool requeue = true);
     // 获取错误信息
     QString getErrorMessage() const;
+    // 获取发送通道的统计信息(帧数、字节数、排队延迟)
+    MqLaneStats getLaneStats(MqLane lane) const;
+    // 获取TLS握手统计(完整握手与会话恢复的耗时、CPU)
+    MqTlsStats getTlsStats() const;
+    // 获取所在线程的域名解析缓存统计，同一线程的实例共用一个缓存
+    MqDnsStats getDnsStats() const;
+    // 获取事务发布统计
+    MqTxStats getTxStats() const;
+    // 获取录制与回放统计
+    MqArchiveStats getArchiveStats() const;
+    // 分片重组对象，用于连接传输完成/失败信号，未启用时为nullptr
+    QMqChunkAssembler *getChunkAssembler() const;
+    // 获取消费端统计信息(本地缓冲占用、暂停次数等)
+    MqConsumerStats getConsumerStats() const;
+    // 获取连接统计(建立次数、出错次数)
+    MqConnectionStats getConnectionStats() const;
+    // 本机共享内存分发的写端，未启用时为nullptr
+    QMqShmRing *getShmRing() const;
 
 
 protected:
@@ -86,33 +244,128 @@ protected:
     // 返回错误信息
     void OnPrintErrMsg(const QString &err);
     // 收到消息
-    void OnConsumeRecved(const AMQP::Message &message, uint64_t deliveryTag, bool redelivered);
+    void OnConsumeRecved(const AMQP::Message &message, uint64_t deliveryTag, bool redelivered, int queueIndex = 0);
 
 protected slots:
-    // 消费者接收到数据后发出此信号，请勿进行耗时操作
-    void OnParseTcpMessage(const QByteArray& msg);
-    // 若设置心跳，发送心跳数据
-    void OnStartHeartbeatTimer(int interval);
     // 处理Tcp错误信息
     void OnTcpErrHandle(const QString &err);
+    // 从本地缓冲分发消息
+    void OnDispatchDeliveries();
+    // 推进重试时间轮，重新分发到期的消息
+    void OnRetryTick();
+    // 在原连接上重建出错的channel
+    void OnRecoverChannels();
+    // 批次等待超过txLingerMs时提交
+    void OnTxLingerTimeout();
+    // 按节奏发送下一批回放消息
+    void OnReplayTick();
+    // 发送队列有余量时继续发送排队中的分片
+    void OnChunkPump();
 
 signals:
     void sigRecvedDataReady(const QByteArray& data);
+    // 携带deliveryTag，手动ack模式下连接此信号。channel重建后tag的高16位为channel代数，旧tag不会误ack新channel的消息
+    void sigRecvedDelivery(const QByteArray& data, quint64 deliveryTag, bool redelivered);
+    // 携带来源队列名，多队列消费时按队列区分处理
+    void sigRecvedQueueMsg(const QString& queueName, const QByteArray& data, quint64 deliveryTag);
     void sigMqConnectError();
+    // 事务批次的结果，失败时批次内的消息均未写入队列
+    void sigTxBatchFinished(quint64 batchId, int messages, bool ok, const QString &err);
+    // 回放结束，messages为发出的消息数
+    void sigReplayFinished(qint64 messages, bool ok, const QString &err);
+    // 分片传输的全部分片已交给连接发送，失败时其余分片不再发送
+    void sigChunkedFinished(const QString &transferId, bool ok, const QString &err);
 
 private:
     bool CreateMqChannel();
     bool CloseMqChannel();
     bool CloseMqConnection();
+    // 本实例在连接上占用的channel数
+    int ChannelsNeeded() const;
+    // 登记到指标表的统计对象
+    MqMetricsSources MetricsSources() const;
     bool CreateMqExchange(const QString &exchangeName, const QString &exchangeType);
     bool CreateMqQueue(const QString &queueName);
     bool BindQueue(const QString &queueName, const QString &exchangeName, const QString &bindingKey);
     bool SetQosValue(const uint16_t val);
+    bool ConsumeQueues();
+    // 按权重分给第index个队列的预取数量
+    uint16_t PrefetchShare(int index) const;
+    // 过滤模式下按帧接收消息，内容头到达时执行过滤
+    void OnFilterBegin(const std::string &exchange, const std::string &routingKey);
+    void OnFilterHeaders(const AMQP::MetaData &meta);
+    void OnFilterData(const char *data, size_t size);
+    void OnFilterComplete(uint64_t deliveryTag, bool redelivered, int queueIndex);
+    // 本地缓冲超过高水位时暂停投递，低于低水位时恢复
+    void PauseDelivery();
+    void ResumeDelivery();
+    void DispatchDelivery(const MqDelivery &delivery);
+    // 是否需要经过本地缓冲：设置了水位、多队列调度、优先级、合并或过期检查
+    bool NeedsBuffering() const;
+    // 拷贝消息内容，生成放入本地缓冲或重试的消息
+    MqDelivery MakeDelivery(const AMQP::Message &message, uint64_t deliveryTag, bool redelivered, int queueIndex) const;
+    // 记入已分发未ack的消息
+    void TrackUnacked(const MqDelivery &delivery);
+    // 内联处理函数的结果：ack、reject(启用重试时进入重试时间轮)或转为普通分发
+    void ApplyInlineResult(MqInlineResult result, const MqDelivery &delivery);
+    void EmitDelivery(const MqDelivery &delivery);
+    // 消息是否已超过截止时间，receivedMs为收到的时间
+    bool IsExpired(const AMQP::MetaData &meta, qint64 receivedMs, qint64 nowMs) const;
+    // 批量丢弃过期消息，不交给应用
+    void DropExpired(const QList<MqDelivery> &expired);
+    // 失败消息放入重试时间轮，超过重试次数时转入死信
+    void ScheduleRetry(uint64_t deliveryTag);
+    // 按时间轮中最近的到期时间启动重试定时器，没有等待的消息时停止
+    void ArmRetryTimer();
+    // 重新分发时间轮中到期的消息
+    void RetryExpired(const QList<uint64_t> &expired);
+    void DeadLetterMsg(uint64_t deliveryTag);
+    // 消息处理完成，释放本地缓冲占用
+    void ReleaseUnacked(uint64_t deliveryTag);
+    // 清空消费相关的本地状态(缓冲、未ack、重试)，channel失效时调用
+    void ResetConsumeState();
+    // 创建bulk/分片发送使用的channel，slot为MqBulkChannel或分片channel序号
+    std::shared_ptr<AMQP::Channel> CreateLaneChannel(int slot);
+    // 创建第index条事务发布使用的channel并开启事务模式
+    std::shared_ptr<AMQP::Channel> CreateTxChannel(int index);
+    // 通知批次失败并计入统计
+    void FailTxBatch(quint64 batchId, int messages, const QString &err);
+    // 以录制的属性直接编码并发送一条回放消息
+    bool PublishRecord(const std::shared_ptr<AMQP::Channel> &channel, const MqArchiveRecord &record);
+    void FinishReplay(bool ok, const QString &err);
+    // channel级错误：可恢复时只重建该channel，否则关闭
+    void OnChannelError(int slot);
+    // 绕过AMQP-CPP直接写帧前检查：channel已打开，且没有等待应答的同步操作或其排队中的帧，
+    // 否则直接写出的帧会先于declare/bind或先前的publish到达broker
+    static bool CanSendEncoded(const std::shared_ptr<AMQP::Channel> &channel);
+    // 交给AMQP-CPP的回调：共享连接上的channel在实例销毁后仍可能收到消息、close-ok或错误，
+    // 实例销毁后回调直接返回，不再访问this
+    template<class Callback>
+    auto Guarded(Callback &&callback) const
+    {
+        std::weak_ptr<bool> alive = m_alive;
+        using Target = const std::decay_t<Callback> &;
+        // 返回类型参与推导，AMQP-CPP按参数个数区分的重载(如onSuccess)才能选中正确的一个
+        return [alive, callback](auto &&... args)
+            -> decltype(std::declval<Target>()(std::forward<decltype(args)>(args)...), void()) {
+            if (!alive.expired()) {
+                callback(std::forward<decltype(args)>(args)...);
+            }
+        };
+    }
+    // 取消consumer并清除channel上的回调，关闭后不再回调本实例
+    void DetachChannel(const std::shared_ptr<AMQP::Channel> &channel);
+    // 应用可见的deliveryTag与broker的deliveryTag互转
+    uint64_t AppTag(uint64_t brokerTag) const;
+    static uint64_t BrokerTag(uint64_t appTag);
 
     // 注册回调函数
     void ChannelOkCb();
-    void ChannelErrCb(const char *msg);
+    void ChannelErrCb(const char *msg, int slot);
     void ChannelCloseErrCb(const char *msg);
+    void TxChannelErrCb(const char *msg, int index);
+    void TxCommitOkCb(quint64 batchId, int messages, qint64 startUs);
+    void TxCommitErrCb(const char *msg, quint64 batchId, int messages);
     void CreatMqExchangeErrCb(const char *msg);
     void CreatMqQueueErrCb(const char *msg);
     void BindQueueErrCb(const char *msg);
@@ -123,15 +376,81 @@ private:
 private:
     MqRoles m_role;
     MqInfo m_mqInfo;
+    std::shared_ptr<QMqConnection> m_pConn = nullptr;
+    int m_connChannels = 0;     // 在共享连接上登记的channel数
     std::shared_ptr<QTcpClient> m_pTcpClient = nullptr;
     std::shared_ptr<QTcpConnectionHandler> m_pHandler = nullptr;
     std::shared_ptr<AMQP::Connection > m_connection = nullptr;
     std::shared_ptr<AMQP::Channel> m_channel = nullptr;
+    std::shared_ptr<AMQP::Channel> m_bulkChannel = nullptr;
+    std::vector<std::shared_ptr<AMQP::Channel>> m_chunkChannels;
+    struct ChunkTransfer {
+        QByteArray data;
+        MqChunkInfo info;
+        QList<uint32_t> pending;    // 尚未发送的分片序号
+    };
+    QQueue<ChunkTransfer> m_chunkTransfers;     // 排队中的分片传输，按bulk通道的余量逐片发出
+    QTimer m_chunkTimer;                        // 分片channel未就绪时稍后重试
+    std::shared_ptr<QMqChunkAssembler> m_pChunkAssembler = nullptr;
+    std::shared_ptr<QMqShmRing> m_pShmRing = nullptr;
+    std::shared_ptr<QMqDedupCache> m_pDedupCache = nullptr;
+
+    QMqDeliveryBuffer m_deliveryBuffer;
+    QHash<uint64_t, MqDelivery> m_unackedDeliveries;  // 已分发未ack的消息，body与应用共享不拷贝
+    QTimer m_dispatchTimer;
+    QList<MqQueueInfo> m_consumeQueues;   // 实际消费的队列列表
+    std::vector<std::string> m_consumerTags;
+    bool m_consumePaused = false;
+    QElapsedTimer m_pauseClock;
+    std::shared_ptr<MqConsumerStats> m_consumerStats = std::make_shared<MqConsumerStats>();
+
+    QMqTimerWheel m_retryWheel;
+    QTimer m_retryTimer;
+    QElapsedTimer m_retryClock;
+    QHash<uint64_t, int> m_retryAttempts;
+    QHash<int, int> m_retryHeld;        // 各队列在时间轮中等待重试的消息数
+    QList<uint64_t> m_supersededTags;   // 合并模式下被替换、待批量ack的消息
+
+    MqConsumeFilter m_consumeFilter = nullptr;
+    MqInlineHandler m_inlineHandler = nullptr;
+    std::shared_ptr<MqStagedMessage> m_stagedMessage = nullptr;  // 过滤模式下正在接收的消息
+    bool m_stagedAccepted = true;
+    uint64_t m_stagedSize = 0;
+
+    uint64_t m_channelGeneration = 0;   // 主channel重建次数，编入deliveryTag高位
+    bool m_consumeStarted = false;
+    bool m_consumeOnReady = false;      // 主channel重建完成后重新consume
+    QTimer m_recoverTimer;
+    QSet<int> m_recoverSlots;           // 待重建的channel
+    int m_channelRecoveries = 0;        // 连续重建次数
+    QElapsedTimer m_recoverClock;
+
+    std::vector<std::shared_ptr<AMQP::Channel>> m_txChannels;
+    int m_txCurrent = 0;                // 当前未提交批次所在的tx channel
+    quint64 m_txBatchId = 1;            // 当前未提交批次的编号
+    int m_txBatchMessages = 0;
+    qint64 m_txBatchBytes = 0;
+    QTimer m_txLingerTimer;
+    QElapsedTimer m_txClock;
+    std::shared_ptr<MqTxStats> m_txStats = std::make_shared<MqTxStats>();
+    std::shared_ptr<MqConnectionStats> m_connStats = std::make_shared<MqConnectionStats>();
+
+    std::shared_ptr<QMqArchiveWriter> m_pArchiveWriter = nullptr;
+    std::shared_ptr<QMqArchiveReader> m_pReplayReader = nullptr;
+    MqReplayConfig m_replayConfig;
+    MqArchiveRecord m_replayRecord;     // 已读出、等待发送时间的消息
+    bool m_replayPending = false;
+    qint64 m_replayBaseUs = 0;          // 第一条回放消息的录制时间
+    qint64 m_replaySent = 0;
+    QTimer m_replayTimer;
+    QElapsedTimer m_replayClock;
+    std::shared_ptr<MqCounter> m_replayed = std::make_shared<MqCounter>();
 
     QMutex m_channelMutex;
-    std::shared_ptr<QTimer> m_heartbeatTimer = nullptr;
     int m_heartbeatInterval = 0;    //心跳时间，单位:秒
     int m_mqConnErrIndex = 0;
+    bool m_initOk = true;               // Init中按配置启用的功能是否全部成功
+    std::shared_ptr<bool> m_alive = std::make_shared<bool>(true);   // 析构时释放，Guarded回调据此判断实例是否存在
     QString m_errMessag;
 };
 
@@ -1,15 +1,30 @@
 #include "QTcpClient.h"
 #include <QDebug>
 #include <QDataStream>
+#include <QSslSocket>
+#include <QSslConfiguration>
+#include <QSslCertificate>
+#include <QMutex>
+#include <QHash>
+#include <ctime>
+#include "QMqDnsCache.h"
 
 
 namespace AMQP_QT {
 
+namespace {
+
+// 进程内共享的session ticket缓存，key为host:port
+QMutex g_ticketMutex;
+QHash<QString, QByteArray> g_sessionTickets;
+
+} //namespace
 
 QTcpClient::QTcpClient(QString addr_host, uint32_t addr_port, QObject *parent)
     :QObject(parent), m_host(addr_host), m_port(addr_port)
 {
     m_pSock = std::make_shared<QTcpSocket>(this);
+    m_clock.start();
 }
 
 QTcpClient::~QTcpClient()
@@ -17,34 +32,281 @@ QTcpClient::~QTcpClient()
     m_pSock->abort();
 }
 
+void QTcpClient::setTlsConfig(const MqTlsConfig &tls)
+{
+    m_tls = tls;
+    if (m_tls.enabled) {
+        m_pSock = std::make_shared<QSslSocket>(this);
+    }
+}
+
 bool QTcpClient::NewConnect()
 {
+    m_lookupPending = false;
     m_pSock->abort();
-    m_pSock->connectToHost(m_host, m_port);
-    if(!m_pSock->waitForConnected(1000 * 5)) {
-        qCritical() << __FUNCTION__ << ", connect server tiemout! host:" << m_host << ", port:" << m_port;
+    // 旧连接上未发出的帧已无意义
+    for (int lane = 0; lane < MqLaneCount; lane++) {
+        m_laneQueues[lane].clear();
+        m_conflated[lane].clear();
+        m_pStats->lanes[lane].queuedFrames.set(0);
+        m_pStats->lanes[lane].queuedBytes.set(0);
+    }
+    // 重连时使用缓存的地址，不再每次解析域名；第一次连接时等异步解析结束后在OnHostLookedUp中继续，
+    // 期间写入的帧留在lane队列中，连接建立后再写出
+    QMqDnsCache *cache = QMqDnsCache::instance();
+    QList<QHostAddress> addresses;
+    if (!cache->Resolve(m_host, addresses, m_errMessage)) {
+        m_lookupPending = true;
+        connect(cache, &QMqDnsCache::sigLookupFinished, this, &QTcpClient::OnHostLookedUp, Qt::UniqueConnection);
+        return true;
+    }
+
+    return this->ConnectAddresses(addresses);
+}
+
+void QTcpClient::OnHostLookedUp(const QString &host, const QList<QHostAddress> &addresses, const QString &err)
+{
+    if (!m_lookupPending || host != m_host) {
+        return;
+    }
+    m_lookupPending = false;
+
+    m_errMessage = err;
+    if (!this->ConnectAddresses(addresses)) {
+        emit sigSocketErr(m_errMessage);
+        return;
+    }
+    this->PumpOutput();
+}
+
+bool QTcpClient::ConnectAddresses(const QList<QHostAddress> &addresses)
+{
+    if (addresses.isEmpty()) {
+        qCritical() << __FUNCTION__ << ", " << m_errMessage;
         return false;
     }
 
-    connect(m_pSock.get(), SIGNAL(readyRead()), this, SLOT(OnGetMsg()));
-    connect(m_pSock.get(), SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(OnSocketErr(QAbstractSocket::SocketError)));
+    // 域名解析出多个地址时按顺序尝试，一个地址不可达时换下一个
+    bool connected = false;
+    for (const QHostAddress &address : addresses) {
+        m_pSock->abort();
+        if (m_tls.enabled) {
+            connected = this->ConnectEncrypted(address);
+        }
+        else {
+            m_pSock->connectToHost(address, m_port);
+            connected = m_pSock->waitForConnected(1000 * 5);
+            if (!connected) {
+                m_errMessage = "Connect Failed: " + address.toString() + " " + m_pSock->errorString();
+            }
+        }
+        if (connected) {
+            break;
+        }
+        qCritical() << __FUNCTION__ << ", connect server failed! host:" << m_host << ", address:" << address.toString()
+                    << ", port:" << m_port << ", " << m_errMessage;
+    }
+    if (!connected) {
+        return false;
+    }
+
+    // 重连时沿用同一个socket，避免信号重复连接导致槽函数被多次调用
+    connect(m_pSock.get(), SIGNAL(readyRead()), this, SLOT(OnGetMsg()), Qt::UniqueConnection);
+    connect(m_pSock.get(), SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(OnSocketErr(QAbstractSocket::SocketError)),
+            Qt::UniqueConnection);
+    connect(m_pSock.get(), SIGNAL(bytesWritten(qint64)), this, SLOT(OnBytesWritten(qint64)), Qt::UniqueConnection);
 
     return true;
 }
 
+bool QTcpClient::ConnectEncrypted(const QHostAddress &address)
+{
+    QSslSocket *sock = qobject_cast<QSslSocket *>(m_pSock.get());
+    if (!sock || !QSslSocket::supportsSsl()) {
+        m_errMessage = "TLS not supported";
+        qCritical() << __FUNCTION__ << m_errMessage;
+        return false;
+    }
+
+    QSslConfiguration config = QSslConfiguration::defaultConfiguration();
+    if (!m_tls.caCertFile.isEmpty()) {
+        config.setCaCertificates(QSslCertificate::fromPath(m_tls.caCertFile));
+    }
+    config.setPeerVerifyMode(m_tls.verifyPeer ? QSslSocket::VerifyPeer : QSslSocket::VerifyNone);
+
+    QByteArray ticket;
+    if (m_tls.sessionResumption) {
+        config.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+        QMutexLocker locker(&g_ticketMutex);
+        ticket = g_sessionTickets.value(this->SessionKey());
+    }
+    if (!ticket.isEmpty()) {
+        config.setSessionTicket(ticket);
+    }
+    sock->setSslConfiguration(config);
+    connect(sock, SIGNAL(newSessionTicketReceived()), this, SLOT(OnSessionTicketReceived()), Qt::UniqueConnection);
+
+    // 按IP连接，证书仍按主机名校验
+    QElapsedTimer elapsed;
+    elapsed.start();
+    std::clock_t cpuStart = std::clock();
+    sock->connectToHostEncrypted(address.toString(), m_port, m_tls.peerName.isEmpty() ? m_host : m_tls.peerName);
+    if (!sock->waitForEncrypted(1000 * 5)) {
+        m_errMessage = sock->errorString();
+        m_pStats->tls.failures.add();
+        qCritical() << __FUNCTION__ << ", tls handshake failed! host:" << m_host << ", port:" << m_port << m_errMessage;
+        // 服务端不接受的ticket不再使用
+        if (!ticket.isEmpty()) {
+            QMutexLocker locker(&g_ticketMutex);
+            g_sessionTickets.remove(this->SessionKey());
+        }
+        return false;
+    }
+
+    qint64 us = elapsed.nsecsElapsed() / 1000;
+    qint64 cpuUs = (qint64)(std::clock() - cpuStart) * 1000000 / CLOCKS_PER_SEC;
+    if (ticket.isEmpty()) {
+        m_pStats->tls.fullHandshakes.add();
+        m_pStats->tls.fullLatency.record(us);
+        m_pStats->tls.fullCpu.record(cpuUs);
+    }
+    else {
+        m_pStats->tls.resumeAttempts.add();
+        m_pStats->tls.resumedLatency.record(us);
+        m_pStats->tls.resumedCpu.record(cpuUs);
+    }
+
+    // TLS1.2的ticket在握手时下发，TLS1.3的在握手后由newSessionTicketReceived通知
+    this->OnSessionTicketReceived();
+    return true;
+}
+
+void QTcpClient::OnSessionTicketReceived()
+{
+    QSslSocket *sock = qobject_cast<QSslSocket *>(m_pSock.get());
+    if (!sock || !m_tls.sessionResumption) {
+        return;
+    }
+
+    QByteArray ticket = sock->sslConfiguration().sessionTicket();
+    if (!ticket.isEmpty()) {
+        QMutexLocker locker(&g_ticketMutex);
+        g_sessionTickets.insert(this->SessionKey(), ticket);
+    }
+}
+
+QString QTcpClient::SessionKey() const
+{
+    // 校验方式或CA不同的连接不能共用ticket，否则恢复会话会绕过新配置的证书校验
+    return m_host + ":" + QString::number(m_port) + "|verify=" + QString::number(m_tls.verifyPeer ? 1 : 0)
+            + "|peer=" + m_tls.peerName + "|ca=" + m_tls.caCertFile;
+}
+
 bool QTcpClient::SendData(const QByteArray &msg)
 {
+    // 直接写socket会越过lane队列，打乱帧顺序，统一走控制通道
+    return this->SendFrame(msg, MqLaneControl);
+}
+
+bool QTcpClient::SendFrame(const QByteArray &frame, MqLane lane)
+{
+    PendingFrame pending;
+    pending.data = frame;
+    pending.enqueueNs = m_clock.nsecsElapsed();
+    m_laneQueues[lane].enqueue(pending);
+    m_pStats->lanes[lane].queuedFrames.add();
+    m_pStats->lanes[lane].queuedBytes.add(frame.size());
+
     try {
-        m_pSock->write(msg);
+        this->PumpOutput();
     }
     catch (const std::exception &e) {
-        m_errMessage = "Send Data Failed: " + QString(e.what());
+        m_errMessage = "Send Frame Failed: " + QString(e.what());
         return false;
     }
 
     return true;
 }
 
+bool QTcpClient::SendConflated(const QString &key, const QByteArray &message, MqLane lane)
+{
+    // 同key的消息尚未写出，原位替换
+    if (m_conflated[lane].contains(key)) {
+        QByteArray &queued = m_conflated[lane][key];
+        m_pStats->lanes[lane].queuedBytes.add(message.size() - queued.size());
+        m_pStats->lanes[lane].conflated.add();
+        queued = message;
+        return true;
+    }
+
+    PendingFrame pending;
+    pending.enqueueNs = m_clock.nsecsElapsed();
+    pending.conflationKey = key;
+    m_conflated[lane].insert(key, message);
+    m_laneQueues[lane].enqueue(pending);
+    m_pStats->lanes[lane].queuedFrames.add();
+    m_pStats->lanes[lane].queuedBytes.add(message.size());
+
+    try {
+        this->PumpOutput();
+    }
+    catch (const std::exception &e) {
+        m_errMessage = "Send Conflated Failed: " + QString(e.what());
+        return false;
+    }
+
+    return true;
+}
+
+void QTcpClient::setWriteWatermark(qint64 bytes)
+{
+    m_writeWatermark = bytes;
+}
+
+MqLaneStats QTcpClient::getLaneStats(MqLane lane) const
+{
+    return m_pStats->lanes[lane];
+}
+
+MqTlsStats QTcpClient::getTlsStats() const
+{
+    return m_pStats->tls;
+}
+
+std::shared_ptr<const MqSocketStats> QTcpClient::getSharedStats() const
+{
+    return m_pStats;
+}
+
+void QTcpClient::PumpOutput()
+{
+    // 解析或连接尚未完成时帧留在队列中
+    if (m_pSock->state() != QAbstractSocket::ConnectedState) {
+        return;
+    }
+
+    while (m_pSock->bytesToWrite() < m_writeWatermark) {
+        // 控制通道优先，保证控制消息不会排在大消息的body帧之后
+        int lane = !m_laneQueues[MqLaneControl].isEmpty() ? MqLaneControl : MqLaneBulk;
+        if (m_laneQueues[lane].isEmpty()) {
+            return;
+        }
+
+        PendingFrame pending = m_laneQueues[lane].dequeue();
+        if (!pending.conflationKey.isEmpty()) {
+            pending.data = m_conflated[lane].take(pending.conflationKey);
+        }
+        m_pStats->lanes[lane].queuedFrames.sub();
+        m_pStats->lanes[lane].queuedBytes.sub(pending.data.size());
+
+        m_pSock->write(pending.data);
+
+        m_pStats->lanes[lane].frames.add();
+        m_pStats->lanes[lane].bytes.add(pending.data.size());
+        m_pStats->lanes[lane].latency.record((m_clock.nsecsElapsed() - pending.enqueueNs) / 1000);
+    }
+}
+
 void QTcpClient::OnErrMsg(const QString &msg)
 {
     m_errMessage = msg;
@@ -58,6 +320,13 @@ void QTcpClient::OnGetMsg()
     emit sigParseTcpMsg(m_message);
 }
 
+void QTcpClient::OnBytesWritten(qint64 bytes)
+{
+    Q_UNUSED(bytes)
+    this->PumpOutput();
+    emit sigOutputWritten();
+}
+
 void QTcpClient::OnSocketErr(QAbstractSocket::SocketError)
 {
     m_errMessage = m_pSock->errorString();
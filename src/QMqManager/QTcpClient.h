@@ -3,10 +3,41 @@
 
 #include <QObject>
 #include <QTcpSocket>
+#include <QHostAddress>
+#include <QQueue>
+#include <QHash>
+#include <QElapsedTimer>
+#include "QMqStats.h"
 
 
 namespace AMQP_QT {
 
+// 发送通道：控制消息走高优先级通道，大数据量消息走bulk通道
+enum MqLane {
+    MqLaneControl = 0,
+    MqLaneBulk = 1,
+    MqLaneCount
+};
+
+// TLS配置
+typedef struct _mqtlsconfig
+{
+    bool enabled = false;
+    QString peerName = "";          // 校验证书使用的主机名，为空时使用连接的host
+    QString caCertFile = "";        // CA证书(PEM)，为空时使用系统证书
+    bool verifyPeer = true;
+    bool sessionResumption = true;  // 缓存session ticket，重连时恢复会话，省去完整握手
+} MqTlsConfig;
+
+/**
+ * @brief The MqSocketStats struct 一条tcp连接的lane和TLS统计
+ */
+struct MqSocketStats
+{
+    MqLaneStats lanes[MqLaneCount];
+    MqTlsStats tls;
+};
+
 
 /**
  * @brief The QTcpClient class
@@ -18,17 +49,57 @@ public:
     QTcpClient(QString addr_host, uint32_t addr_port, QObject *parent = nullptr);
     ~QTcpClient();
 
+    // 启用TLS时在NewConnect之前调用
+    void setTlsConfig(const MqTlsConfig &tls);
+    // 建立连接。域名还没有解析结果时发起异步解析并返回true，解析结束后继续连接，失败时发出sigSocketErr
     bool NewConnect();
     bool SendData(const QByteArray &msg);
+    // 按帧发送，帧先进入对应lane的队列，由输出调度按帧粒度交错写入socket
+    bool SendFrame(const QByteArray &frame, MqLane lane);
+    // 发送可合并的完整消息(方法帧+内容头帧+body帧)。同key的消息还在lane队列中未写出时，
+    // 直接替换其内容并保留原排队位置，只发送最新值
+    bool SendConflated(const QString &key, const QByteArray &message, MqLane lane);
     void OnErrMsg(const QString &msg);
 
+    // socket内待发送数据的上限，超过后帧留在lane队列中等待调度
+    void setWriteWatermark(qint64 bytes);
+    // 获取lane统计信息
+    MqLaneStats getLaneStats(MqLane lane) const;
+    // 获取TLS握手统计
+    MqTlsStats getTlsStats() const;
+    // 统计对象本身，供其他线程读取
+    std::shared_ptr<const MqSocketStats> getSharedStats() const;
+
 protected slots:
     void OnGetMsg();
     void OnSocketErr(QAbstractSocket::SocketError);
+    // socket数据写出后继续调度
+    void OnBytesWritten(qint64 bytes);
+    // 保存服务端下发的session ticket，供下次重连恢复会话
+    void OnSessionTicketReceived();
+    // 异步解析结束，继续连接
+    void OnHostLookedUp(const QString &host, const QList<QHostAddress> &addresses, const QString &err);
 
 signals:
     void sigParseTcpMsg(const QByteArray&);
     void sigSocketErr(const QString&);
+    // socket写出数据后lane队列有了余量，供上层继续发送排队中的大数据
+    void sigOutputWritten();
+
+private:
+    // 输出调度：控制通道优先，bulk通道只在控制通道为空时写出一帧
+    void PumpOutput();
+    // 按顺序尝试各地址，连接成功后开始收发
+    bool ConnectAddresses(const QList<QHostAddress> &addresses);
+    // TLS连接并完成握手
+    bool ConnectEncrypted(const QHostAddress &address);
+    QString SessionKey() const;
+
+    struct PendingFrame {
+        QByteArray data;
+        qint64 enqueueNs;
+        QString conflationKey;  // 非空时data在写出前从m_conflated中取
+    };
 
 private:
     QString m_host;
@@ -36,6 +107,15 @@ private:
 
     std::shared_ptr<QTcpSocket> m_pSock;
     QString m_errMessage;
+
+    QQueue<PendingFrame> m_laneQueues[MqLaneCount];
+    QHash<QString, QByteArray> m_conflated[MqLaneCount];  // 排队中的可合并消息，key -> 最新内容
+    QElapsedTimer m_clock;
+    qint64 m_writeWatermark = 64 * 1024;
+
+    MqTlsConfig m_tls;
+    bool m_lookupPending = false;   // 等待域名异步解析，结束后继续连接
+    std::shared_ptr<MqSocketStats> m_pStats = std::make_shared<MqSocketStats>();
 };
 
 
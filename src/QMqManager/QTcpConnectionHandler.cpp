@@ -2,6 +2,7 @@
 #include <QDebug>
 #include <QtGlobal>
 #include "QTcpClient.h"
+#include "QMqFrameEncoder.h"
 
 
 using namespace std;
@@ -29,6 +30,68 @@ uint16_t QTcpConnectionHandler::getHeartbeatInterval() const
     return m_heartbeatInterval;
 }
 
+void QTcpConnectionHandler::setChannelLane(uint16_t channelId, MqLane lane)
+{
+    if (lane == MqLaneBulk) {
+        m_bulkChannels.insert(channelId);
+    }
+    else {
+        m_bulkChannels.remove(channelId);
+    }
+}
+
+void QTcpConnectionHandler::SendEncodedFrame(const QByteArray &frame)
+{
+    if (!m_pTcpClient || frame.size() < (int)QMqFrameEncoder::FrameOverhead) {
+        return;
+    }
+
+    uint16_t channelId = (uint16_t)(((uchar)frame.at(1) << 8) | (uchar)frame.at(2));
+    MqLane lane = m_bulkChannels.contains(channelId) ? MqLaneBulk : MqLaneControl;
+    // QByteArray隐式共享，同一body帧发往多个目标时不会拷贝
+    m_pTcpClient->SendFrame(frame, lane);
+}
+
+void QTcpConnectionHandler::DispatchFrames(const char *data, size_t size)
+{
+    // 帧格式: type(1) + channel(2) + payloadSize(4) + payload + frameEnd(1)
+    const size_t headerSize = QMqFrameEncoder::FrameHeaderSize;
+
+    QByteArray buffered;
+    if (!m_partialFrame.isEmpty()) {
+        m_partialFrame.append(data, (int)size);
+        buffered = m_partialFrame;
+        m_partialFrame.clear();
+        data = buffered.constData();
+        size = buffered.size();
+    }
+
+    size_t offset = 0;
+    // 连接建立时的协议头"AMQP\0\0\9\1"不是帧，直接走控制通道
+    if (size >= 8 && memcmp(data, "AMQP", 4) == 0) {
+        m_pTcpClient->SendFrame(QByteArray(data, 8), MqLaneControl);
+        offset = 8;
+    }
+
+    while (size - offset >= headerSize) {
+        const uchar *frame = reinterpret_cast<const uchar *>(data + offset);
+        uint16_t channelId = (uint16_t)((frame[1] << 8) | frame[2]);
+        uint32_t payloadSize = ((uint32_t)frame[3] << 24) | ((uint32_t)frame[4] << 16) | ((uint32_t)frame[5] << 8) | frame[6];
+        size_t frameSize = headerSize + payloadSize + 1;
+        if (size - offset < frameSize) {
+            break;
+        }
+
+        MqLane lane = m_bulkChannels.contains(channelId) ? MqLaneBulk : MqLaneControl;
+        m_pTcpClient->SendFrame(QByteArray(data + offset, (int)frameSize), lane);
+        offset += frameSize;
+    }
+
+    if (offset < size) {
+        m_partialFrame = QByteArray(data + offset, (int)(size - offset));
+    }
+}
+
 void QTcpConnectionHandler::onData(AMQP::Connection *connection, const char *data, size_t size)
 {
     Q_UNUSED(connection)
@@ -38,9 +101,8 @@ void QTcpConnectionHandler::onData(AMQP::Connection *connection, const char *dat
             return;
         }
 
-        QByteArray msg(data, size);
-        //qDebug() << "QTcpConnectionHandler::onData, send:" << msg;
-        m_pTcpClient->SendData(msg);
+        //qDebug() << "QTcpConnectionHandler::onData, send:" << QByteArray(data, size);
+        this->DispatchFrames(data, size);
     }
     catch (const std::exception&e) {
         m_pTcpClient->OnErrMsg("To MqServer, Send Data Failed: " + QString(e.what()));
@@ -2,14 +2,13 @@
 #define QTCPCONNECTIONHANDLER_H
 
 #include <QObject>
+#include <QSet>
 #include "amqpcpp.h"
+#include "QTcpClient.h"
 
 
 namespace AMQP_QT {
 
-class QTcpClient;
-
-
 /**
  * @brief The QTcpConnectionHandler class
  */
@@ -25,6 +24,10 @@ public:
     void setHeartbeatInterval(int interval);
     // 获取心跳间隔
     uint16_t getHeartbeatInterval() const;
+    // 指定channel的帧走bulk通道，其余(包括channel 0)走控制通道
+    void setChannelLane(uint16_t channelId, MqLane lane);
+    // 发送在AMQP-CPP之外编码好的完整帧，按channel选择lane
+    void SendEncodedFrame(const QByteArray &frame);
 
     // 数据待发送出去
     virtual void onData(AMQP::Connection *connection, const char *data, size_t size) override;
@@ -41,8 +44,14 @@ protected:
 signals:
     void sigStartHeartbeatTimer(int);
 
+private:
+    // 按AMQP帧边界拆分待发送数据，分发到各自的lane
+    void DispatchFrames(const char *data, size_t size);
+
 private:
     std::shared_ptr<QTcpClient> m_pTcpClient = nullptr;
+    QSet<uint16_t> m_bulkChannels;
+    QByteArray m_partialFrame;  // 跨onData调用的不完整帧
 
     int m_heartbeatInterval = 0;
 };
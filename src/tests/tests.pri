@@ -0,0 +1,14 @@
+QT -= gui
+QT += core network testlib
+
+CONFIG += c++11 c++17 console testcase
+CONFIG -= app_bundle
+
+MQ_DIR = $$PWD/../QMqManager
+INCLUDEPATH += $$MQ_DIR
+
+## RabbitMQ client
+INCLUDEPATH += $$PWD/../AmpqCpp/include
+win32 {
+    LIBS += $$PWD/../AmpqCpp/lib/amqpcpp.lib
+}
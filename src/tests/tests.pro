@@ -0,0 +1,14 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    tst_qmqarchive \
+    tst_qmqchunkassembler \
+    tst_qmqdedupcache \
+    tst_qmqdeliverybuffer \
+    tst_qmqshmring \
+    tst_qmqtimerwheel
+
+# linux_tcp模块的TcpHandler冒烟测试
+linux {
+    SUBDIRS += tst_qmqtcphandlers
+}
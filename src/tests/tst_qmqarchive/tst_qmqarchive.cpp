@@ -0,0 +1,121 @@
+#include <QtTest>
+#include <string>
+#include "amqpcpp.h"
+#include "QMqArchive.h"
+
+using namespace AMQP_QT;
+
+
+// AMQP::Message只能由库在收到消息时填充，测试中直接设置body
+class TestMessage : public AMQP::Message
+{
+public:
+    TestMessage(const std::string &exchange, const std::string &routingKey, const std::string &body)
+        : AMQP::Message(exchange, routingKey), m_body(body)
+    {
+        this->setBodySize(m_body.size());
+        this->append(m_body.data(), m_body.size());
+    }
+
+private:
+    std::string m_body;
+};
+
+
+class tst_QMqArchive : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void reopenContinuesSequence();
+    void seekTime();
+};
+
+void tst_QMqArchive::roundTrip()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QMqArchiveWriter writer;
+    QVERIFY(writer.Open(dir.path()));
+    TestMessage first("ex", "rk.1", "hello");
+    first.setContentType("text/plain");
+    QVERIFY(writer.Append(first, false));
+    QVERIFY(writer.Append(TestMessage("ex", "rk.2", "world"), true));
+    QCOMPARE(writer.getStats().records.load(), (uint64_t)2);
+    writer.Close();
+
+    QMqArchiveReader reader;
+    QVERIFY(reader.Open(dir.path()));
+    MqArchiveRecord record;
+    QVERIFY(reader.Next(record));
+    QCOMPARE(record.sequence, (quint64)0);
+    QCOMPARE(record.exchange, QByteArray("ex"));
+    QCOMPARE(record.routingKey, QByteArray("rk.1"));
+    QCOMPARE(record.body, QByteArray("hello"));
+    QVERIFY(!record.redelivered);
+    QVERIFY(!record.properties.isEmpty());
+
+    QVERIFY(reader.Next(record));
+    QCOMPARE(record.sequence, (quint64)1);
+    QCOMPARE(record.body, QByteArray("world"));
+    QVERIFY(record.redelivered);
+    QVERIFY(!reader.Next(record));
+}
+
+void tst_QMqArchive::reopenContinuesSequence()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QMqArchiveWriter writer;
+    QVERIFY(writer.Open(dir.path()));
+    QVERIFY(writer.Append(TestMessage("ex", "rk", "a"), false));
+    QVERIFY(writer.Append(TestMessage("ex", "rk", "b"), false));
+    writer.Close();
+
+    // 重新打开时新开一段，序号接着上一段
+    QVERIFY(writer.Open(dir.path()));
+    QVERIFY(writer.Append(TestMessage("ex", "rk", "c"), false));
+    writer.Close();
+
+    QMqArchiveReader reader;
+    QVERIFY(reader.Open(dir.path()));
+    MqArchiveRecord record;
+    QList<QByteArray> bodies;
+    while (reader.Next(record)) {
+        QCOMPARE(record.sequence, (quint64)bodies.size());
+        bodies.append(record.body);
+    }
+    QCOMPARE(bodies, QList<QByteArray>({ "a", "b", "c" }));
+}
+
+void tst_QMqArchive::seekTime()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QMqArchiveWriter writer;
+    QVERIFY(writer.Open(dir.path()));
+    QVERIFY(writer.Append(TestMessage("ex", "rk", "early"), false));
+    QTest::qSleep(5);
+    QVERIFY(writer.Append(TestMessage("ex", "rk", "late"), false));
+    writer.Close();
+
+    QMqArchiveReader reader;
+    QVERIFY(reader.Open(dir.path()));
+    MqArchiveRecord record;
+    QVERIFY(reader.Next(record));
+    QVERIFY(reader.Next(record));
+    qint64 lateUs = record.timestampUs;
+
+    QVERIFY(reader.SeekTime(lateUs));
+    QVERIFY(reader.Next(record));
+    QCOMPARE(record.body, QByteArray("late"));
+    QVERIFY(!reader.Next(record));
+}
+
+QTEST_GUILESS_MAIN(tst_QMqArchive)
+
+#include "tst_qmqarchive.moc"
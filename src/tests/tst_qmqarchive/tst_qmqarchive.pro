@@ -0,0 +1,11 @@
+include(../tests.pri)
+
+TARGET = tst_qmqarchive
+
+SOURCES += \
+    $$MQ_DIR/QMqArchive.cpp \
+    tst_qmqarchive.cpp
+
+HEADERS += \
+    $$MQ_DIR/QMqArchive.h \
+    $$MQ_DIR/QMqStats.h
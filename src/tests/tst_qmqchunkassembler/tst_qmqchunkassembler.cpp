@@ -0,0 +1,158 @@
+#include <QtTest>
+#include "QMqChunkAssembler.h"
+
+using namespace AMQP_QT;
+
+
+class tst_QMqChunkAssembler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void inOrder();
+    void lastChunkFirst();
+    void lastChunkFirstRejectsBadLayout();
+    void duplicateChunk();
+    void checksumMismatch();
+    void resumeFromFile();
+
+private:
+    // 按stride切分data，返回第index片的分片信息
+    static MqChunkInfo MakeChunk(const QString &transferId, const QByteArray &data, int stride, uint32_t index,
+                                 QByteArray &chunk);
+    static bool Append(QMqChunkAssembler &assembler, const QString &transferId, const QByteArray &data,
+                       int stride, uint32_t index);
+};
+
+MqChunkInfo tst_QMqChunkAssembler::MakeChunk(const QString &transferId, const QByteArray &data, int stride,
+                                             uint32_t index, QByteArray &chunk)
+{
+    MqChunkInfo info;
+    info.transferId = transferId;
+    info.index = index;
+    info.count = (uint32_t)((data.size() + stride - 1) / stride);
+    info.offset = (uint64_t)index * stride;
+    info.totalSize = (uint64_t)data.size();
+    chunk = data.mid((int)info.offset, stride);
+    info.crc32 = QMqChunkAssembler::Crc32(chunk.constData(), chunk.size());
+    return info;
+}
+
+bool tst_QMqChunkAssembler::Append(QMqChunkAssembler &assembler, const QString &transferId, const QByteArray &data,
+                                   int stride, uint32_t index)
+{
+    QByteArray chunk;
+    MqChunkInfo info = MakeChunk(transferId, data, stride, index, chunk);
+    return assembler.AppendChunk(info, chunk.constData(), chunk.size());
+}
+
+void tst_QMqChunkAssembler::inOrder()
+{
+    QMqChunkAssembler assembler;
+    QSignalSpy spy(&assembler, &QMqChunkAssembler::sigTransferCompleted);
+    QByteArray data = "abcdefghij";
+
+    QVERIFY(Append(assembler, "t1", data, 4, 0));
+    QVERIFY(Append(assembler, "t1", data, 4, 1));
+    QCOMPARE(spy.count(), 0);
+    QVERIFY(Append(assembler, "t1", data, 4, 2));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toString(), QString("t1"));
+    QCOMPARE(spy.at(0).at(1).toByteArray(), data);
+}
+
+void tst_QMqChunkAssembler::lastChunkFirst()
+{
+    QMqChunkAssembler assembler;
+    QSignalSpy spy(&assembler, &QMqChunkAssembler::sigTransferCompleted);
+    QByteArray data = "abcdefghij";
+
+    // 末尾分片先到，由它的offset推出分片大小
+    QVERIFY(Append(assembler, "t2", data, 4, 2));
+    QVERIFY(Append(assembler, "t2", data, 4, 0));
+    QVERIFY(Append(assembler, "t2", data, 4, 1));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(1).toByteArray(), data);
+}
+
+void tst_QMqChunkAssembler::lastChunkFirstRejectsBadLayout()
+{
+    QMqChunkAssembler assembler;
+    QByteArray data = "abcdefghij";
+    QVERIFY(Append(assembler, "t3", data, 4, 2));
+
+    // 分片大小与末尾分片推出的不一致
+    QByteArray chunk = data.left(3);
+    MqChunkInfo info;
+    info.transferId = "t3";
+    info.index = 0;
+    info.count = 3;
+    info.offset = 0;
+    info.totalSize = (uint64_t)data.size();
+    info.crc32 = QMqChunkAssembler::Crc32(chunk.constData(), chunk.size());
+    QVERIFY(!assembler.AppendChunk(info, chunk.constData(), chunk.size()));
+
+    // offset无法被分片数整除的末尾分片
+    chunk = data.mid(9);
+    info.transferId = "t4";
+    info.index = 2;
+    info.offset = 9;
+    info.crc32 = QMqChunkAssembler::Crc32(chunk.constData(), chunk.size());
+    QVERIFY(!assembler.AppendChunk(info, chunk.constData(), chunk.size()));
+}
+
+void tst_QMqChunkAssembler::duplicateChunk()
+{
+    QMqChunkAssembler assembler;
+    QSignalSpy spy(&assembler, &QMqChunkAssembler::sigTransferCompleted);
+    QByteArray data = "abcdefghij";
+
+    // 重复投递的分片直接返回成功，不重复计数
+    QVERIFY(Append(assembler, "t5", data, 4, 0));
+    QVERIFY(Append(assembler, "t5", data, 4, 0));
+    QVERIFY(Append(assembler, "t5", data, 4, 1));
+    QCOMPARE(spy.count(), 0);
+    QVERIFY(Append(assembler, "t5", data, 4, 2));
+    QCOMPARE(spy.count(), 1);
+}
+
+void tst_QMqChunkAssembler::checksumMismatch()
+{
+    QMqChunkAssembler assembler;
+    QByteArray data = "abcdefghij";
+    QByteArray chunk;
+    MqChunkInfo info = MakeChunk("t6", data, 4, 0, chunk);
+    info.crc32 ^= 1;
+    QVERIFY(!assembler.AppendChunk(info, chunk.constData(), chunk.size()));
+    QVERIFY(assembler.getErrorMessage().contains("checksum"));
+}
+
+void tst_QMqChunkAssembler::resumeFromFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QByteArray data = "abcdefghij";
+
+    {
+        QMqChunkAssembler assembler;
+        assembler.setOutputDir(dir.path());
+        QVERIFY(Append(assembler, "t7", data, 4, 0));
+    }
+
+    // 进程重启后按.chunks记录续传，只需补齐剩余分片
+    QMqChunkAssembler assembler;
+    assembler.setOutputDir(dir.path());
+    QSignalSpy spy(&assembler, &QMqChunkAssembler::sigTransferFileReady);
+    QVERIFY(Append(assembler, "t7", data, 4, 2));
+    QVERIFY(Append(assembler, "t7", data, 4, 1));
+    QCOMPARE(spy.count(), 1);
+
+    QFile file(spy.at(0).at(1).toString());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), data);
+    QVERIFY(!QFile::exists(file.fileName() + ".chunks"));
+}
+
+QTEST_GUILESS_MAIN(tst_QMqChunkAssembler)
+
+#include "tst_qmqchunkassembler.moc"
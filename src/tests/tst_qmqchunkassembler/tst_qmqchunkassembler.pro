@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_qmqchunkassembler
+
+SOURCES += \
+    $$MQ_DIR/QMqChunkAssembler.cpp \
+    tst_qmqchunkassembler.cpp
+
+HEADERS += \
+    $$MQ_DIR/QMqChunkAssembler.h
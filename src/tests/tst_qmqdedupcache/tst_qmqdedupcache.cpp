@@ -0,0 +1,94 @@
+#include <QtTest>
+#include "QMqDedupCache.h"
+
+using namespace AMQP_QT;
+
+
+class tst_QMqDedupCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void windowEviction();
+    void duplicateKeysCounted();
+    void zeroKeyIgnored();
+    void bloomGenerations();
+    void persistReload();
+};
+
+void tst_QMqDedupCache::windowEviction()
+{
+    QMqDedupCache cache(3);
+    for (uint64_t key = 1; key <= 4; key++) {
+        cache.insert(key);
+    }
+    QCOMPARE(cache.size(), 3);
+    QVERIFY(!cache.contains(1));
+    QVERIFY(cache.contains(2));
+    QVERIFY(cache.contains(3));
+    QVERIFY(cache.contains(4));
+}
+
+void tst_QMqDedupCache::duplicateKeysCounted()
+{
+    QMqDedupCache cache(2);
+    cache.insert(5);
+    cache.insert(5);
+
+    // 窗口中还有一条相同指纹时仍视为重复
+    cache.insert(6);
+    QVERIFY(cache.contains(5));
+    cache.insert(7);
+    QVERIFY(!cache.contains(5));
+}
+
+void tst_QMqDedupCache::zeroKeyIgnored()
+{
+    QMqDedupCache cache(4);
+    cache.insert(0);
+    QCOMPARE(cache.size(), 0);
+    QVERIFY(!cache.contains(0));
+}
+
+void tst_QMqDedupCache::bloomGenerations()
+{
+    // 过滤器轮换多代后，窗口内的记录仍全部命中，窗口外的不会误判
+    QMqDedupCache cache(4);
+    for (uint64_t key = 1; key <= 20; key++) {
+        cache.insert(key * 0x9E3779B97F4A7C15ULL);
+    }
+    for (uint64_t key = 1; key <= 20; key++) {
+        QCOMPARE(cache.contains(key * 0x9E3779B97F4A7C15ULL), key > 16);
+    }
+}
+
+void tst_QMqDedupCache::persistReload()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.filePath("dedup.dat");
+
+    {
+        QMqDedupCache cache(8);
+        QVERIFY(cache.OpenPersist(path));
+        cache.insert(11);
+        cache.insert(12);
+    }
+
+    // 重启后载入崩溃前的记录
+    QMqDedupCache reloaded(8);
+    QVERIFY(reloaded.OpenPersist(path));
+    QCOMPARE(reloaded.size(), 2);
+    QVERIFY(reloaded.contains(11));
+    QVERIFY(reloaded.contains(12));
+
+    // 窗口大小改变后旧文件无法沿用
+    QMqDedupCache resized(16);
+    QVERIFY(resized.OpenPersist(path));
+    QCOMPARE(resized.size(), 0);
+    QVERIFY(!resized.contains(11));
+}
+
+QTEST_GUILESS_MAIN(tst_QMqDedupCache)
+
+#include "tst_qmqdedupcache.moc"
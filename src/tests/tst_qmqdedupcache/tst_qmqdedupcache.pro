@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_qmqdedupcache
+
+SOURCES += \
+    $$MQ_DIR/QMqDedupCache.cpp \
+    tst_qmqdedupcache.cpp
+
+HEADERS += \
+    $$MQ_DIR/QMqDedupCache.h
@@ -0,0 +1,184 @@
+#include <QtTest>
+#include <algorithm>
+#include "QMqDeliveryBuffer.h"
+
+using namespace AMQP_QT;
+
+
+class tst_QMqDeliveryBuffer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void weightedRoundRobin();
+    void strictPriorityQueue();
+    void priorityLevels();
+    void conflationReplacesInPlace();
+    void conflationScopedPerQueue();
+    void conflationPriorityChange();
+    void conflationEmptyKey();
+    void watermarks();
+
+private:
+    // priority小于0表示不带priority属性
+    static MqDelivery MakeDelivery(uint64_t tag, int queueIndex, const QByteArray &body,
+                                   const QString &key = QString(), int priority = -1);
+};
+
+MqDelivery tst_QMqDeliveryBuffer::MakeDelivery(uint64_t tag, int queueIndex, const QByteArray &body,
+                                               const QString &key, int priority)
+{
+    MqDelivery delivery;
+    delivery.deliveryTag = tag;
+    delivery.queueIndex = queueIndex;
+    delivery.body = body;
+    delivery.conflationKey = key;
+    if (priority >= 0) {
+        delivery.meta.setPriority((uint8_t)priority);
+    }
+    return delivery;
+}
+
+void tst_QMqDeliveryBuffer::weightedRoundRobin()
+{
+    QMqDeliveryBuffer buffer;
+    buffer.setQueueWeights({ 2, 1 }, MqScheduleWeighted);
+    for (int i = 0; i < 6; i++) {
+        buffer.push(MakeDelivery(i + 1, 0, "a"));
+    }
+    for (int i = 0; i < 3; i++) {
+        buffer.push(MakeDelivery(i + 101, 1, "b"));
+    }
+
+    // 平滑加权轮询：权重2:1时按0,1,0交替，低权重队列不会被饿死
+    QList<int> order;
+    for (int i = 0; i < 6; i++) {
+        order.append(buffer.pop().queueIndex);
+    }
+    QCOMPARE(order, QList<int>({ 0, 1, 0, 0, 1, 0 }));
+    QCOMPARE(buffer.bufferedMessages(), 3);
+}
+
+void tst_QMqDeliveryBuffer::strictPriorityQueue()
+{
+    QMqDeliveryBuffer buffer;
+    buffer.setQueueWeights({ 1, 3 }, MqScheduleStrict);
+    buffer.push(MakeDelivery(1, 0, "a"));
+    buffer.push(MakeDelivery(2, 1, "b"));
+    buffer.push(MakeDelivery(3, 1, "b"));
+
+    QCOMPARE(buffer.pop().deliveryTag, (uint64_t)2);
+    QCOMPARE(buffer.pop().deliveryTag, (uint64_t)3);
+    QCOMPARE(buffer.pop().deliveryTag, (uint64_t)1);
+    QVERIFY(buffer.isEmpty());
+}
+
+void tst_QMqDeliveryBuffer::priorityLevels()
+{
+    QMqDeliveryBuffer buffer;
+    buffer.setPriorityLevels(3);
+    buffer.push(MakeDelivery(1, 0, "a", QString(), 0));
+    buffer.push(MakeDelivery(2, 0, "a", QString(), 9));
+    buffer.push(MakeDelivery(3, 0, "a"));
+    buffer.push(MakeDelivery(4, 0, "a", QString(), 1));
+
+    // 超出级数的按最高级，同级先进先出
+    QCOMPARE(buffer.pop().deliveryTag, (uint64_t)2);
+    QCOMPARE(buffer.pop().deliveryTag, (uint64_t)4);
+    QCOMPARE(buffer.pop().deliveryTag, (uint64_t)1);
+    QCOMPARE(buffer.pop().deliveryTag, (uint64_t)3);
+}
+
+void tst_QMqDeliveryBuffer::conflationReplacesInPlace()
+{
+    QMqDeliveryBuffer buffer;
+    uint64_t superseded = 0;
+    QVERIFY(!buffer.pushConflated(MakeDelivery(1, 0, "old", "a"), superseded));
+    QVERIFY(!buffer.pushConflated(MakeDelivery(2, 0, "b", "b"), superseded));
+    QVERIFY(buffer.pushConflated(MakeDelivery(3, 0, "newest", "a"), superseded));
+    QCOMPARE(superseded, (uint64_t)1);
+    QCOMPARE(buffer.bufferedMessages(), 2);
+    QCOMPARE(buffer.bufferedBytes(), (qint64)7);
+
+    // 替换后保留原排队位置，出队时取最新内容
+    MqDelivery first = buffer.pop();
+    QCOMPARE(first.deliveryTag, (uint64_t)3);
+    QCOMPARE(first.body, QByteArray("newest"));
+    QVERIFY(!first.placeholder);
+    QCOMPARE(buffer.pop().deliveryTag, (uint64_t)2);
+    QVERIFY(buffer.isEmpty());
+    QCOMPARE(buffer.bufferedBytes(), (qint64)0);
+}
+
+void tst_QMqDeliveryBuffer::conflationScopedPerQueue()
+{
+    QMqDeliveryBuffer buffer;
+    buffer.setQueueWeights({ 1, 1 }, MqScheduleWeighted);
+    uint64_t superseded = 0;
+    QVERIFY(!buffer.pushConflated(MakeDelivery(1, 0, "a", "key"), superseded));
+    QVERIFY(!buffer.pushConflated(MakeDelivery(2, 1, "b", "key"), superseded));
+    QCOMPARE(buffer.bufferedMessages(), 2);
+
+    QList<uint64_t> tags { buffer.pop().deliveryTag, buffer.pop().deliveryTag };
+    std::sort(tags.begin(), tags.end());
+    QCOMPARE(tags, QList<uint64_t>({ 1, 2 }));
+}
+
+void tst_QMqDeliveryBuffer::conflationPriorityChange()
+{
+    QMqDeliveryBuffer buffer;
+    buffer.setPriorityLevels(3);
+    uint64_t superseded = 0;
+    QVERIFY(!buffer.pushConflated(MakeDelivery(1, 0, "a", "a", 0), superseded));
+    QVERIFY(!buffer.pushConflated(MakeDelivery(2, 0, "b", "b", 0), superseded));
+    QVERIFY(buffer.pushConflated(MakeDelivery(3, 0, "a", "a", 2), superseded));
+    QCOMPARE(superseded, (uint64_t)1);
+    QCOMPARE(buffer.bufferedMessages(), 2);
+
+    // 优先级提高后占位移到新优先级，原优先级中不再残留
+    QCOMPARE(buffer.pop().deliveryTag, (uint64_t)3);
+    QCOMPARE(buffer.pop().deliveryTag, (uint64_t)2);
+    QVERIFY(buffer.isEmpty());
+}
+
+void tst_QMqDeliveryBuffer::conflationEmptyKey()
+{
+    QMqDeliveryBuffer buffer;
+    uint64_t superseded = 0;
+    // key为空(如fanout且没有key头)的消息不合并，也不能以占位出队
+    QVERIFY(!buffer.pushConflated(MakeDelivery(1, 0, "first"), superseded));
+    QVERIFY(!buffer.pushConflated(MakeDelivery(2, 0, "second"), superseded));
+    QCOMPARE(buffer.bufferedMessages(), 2);
+    QCOMPARE(buffer.bufferedBytes(), (qint64)11);
+
+    MqDelivery first = buffer.pop();
+    QCOMPARE(first.deliveryTag, (uint64_t)1);
+    QCOMPARE(first.body, QByteArray("first"));
+    MqDelivery second = buffer.pop();
+    QCOMPARE(second.deliveryTag, (uint64_t)2);
+    QCOMPARE(second.body, QByteArray("second"));
+    QVERIFY(buffer.isEmpty());
+    QCOMPARE(buffer.bufferedBytes(), (qint64)0);
+}
+
+void tst_QMqDeliveryBuffer::watermarks()
+{
+    QMqDeliveryBuffer buffer;
+    buffer.setWatermarks(0, 0, 4, 2);
+    for (int i = 0; i < 3; i++) {
+        buffer.push(MakeDelivery(i + 1, 0, "a"));
+    }
+    QVERIFY(!buffer.aboveHighWatermark());
+
+    // 已分发未ack的消息同样计入占用
+    buffer.addUnacked(1);
+    QVERIFY(buffer.aboveHighWatermark());
+    buffer.pop();
+    QVERIFY(!buffer.belowLowWatermark());
+    buffer.removeUnacked(1);
+    QVERIFY(buffer.belowLowWatermark());
+}
+
+QTEST_GUILESS_MAIN(tst_QMqDeliveryBuffer)
+
+#include "tst_qmqdeliverybuffer.moc"
@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_qmqdeliverybuffer
+
+SOURCES += \
+    $$MQ_DIR/QMqDeliveryBuffer.cpp \
+    tst_qmqdeliverybuffer.cpp
+
+HEADERS += \
+    $$MQ_DIR/QMqDeliveryBuffer.h
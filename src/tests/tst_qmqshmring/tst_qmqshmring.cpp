@@ -0,0 +1,95 @@
+#include <QtTest>
+#include "QMqShmRing.h"
+
+using namespace AMQP_QT;
+
+
+class tst_QMqShmRing : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void writeAndRead();
+    void secondWriterRefused();
+    void dropNewKeepsUnreadData();
+
+private:
+    // 每个用例使用独立的key，避免残留的共享内存互相影响
+    static QString MakeKey(const char *name);
+};
+
+QString tst_QMqShmRing::MakeKey(const char *name)
+{
+    return QString("tst_qmqshmring_%1_%2").arg(QCoreApplication::applicationPid()).arg(name);
+}
+
+void tst_QMqShmRing::writeAndRead()
+{
+    QString key = MakeKey("rw");
+    QMqShmRing writer;
+    QVERIFY(writer.CreateWriter(key, 64 * 1024));
+    QVERIFY(writer.isWriter());
+
+    QMqShmRing reader;
+    QVERIFY(reader.AttachReader(key));
+    QSignalSpy spy(&reader, &QMqShmRing::sigShmMessage);
+
+    QVERIFY(writer.Write("ex", "rk", "body1"));
+    QVERIFY(writer.Write("ex", "rk", "body2"));
+    QCOMPARE(reader.ReadAvailable(), 2);
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(spy.at(0).at(0).toByteArray(), QByteArray("ex"));
+    QCOMPARE(spy.at(0).at(1).toByteArray(), QByteArray("rk"));
+    QCOMPARE(spy.at(0).at(2).toByteArray(), QByteArray("body1"));
+    QCOMPARE(spy.at(1).at(2).toByteArray(), QByteArray("body2"));
+    QCOMPARE(reader.ReadAvailable(), 0);
+}
+
+void tst_QMqShmRing::secondWriterRefused()
+{
+    QString key = MakeKey("owner");
+    QMqShmRing writer;
+    QVERIFY(writer.CreateWriter(key, 64 * 1024));
+    QMqShmRing reader;
+    QVERIFY(reader.AttachReader(key));
+
+    // 写端心跳未超时，不能被接管
+    QMqShmRing other;
+    QVERIFY(!other.CreateWriter(key, 64 * 1024));
+    QVERIFY(other.getErrorMessage().contains("still alive"));
+
+    // 写端退出后立即让出，沿用原有位置，读端不受影响
+    writer.Detach();
+    QVERIFY(other.CreateWriter(key, 64 * 1024));
+    QSignalSpy spy(&reader, &QMqShmRing::sigShmMessage);
+    QVERIFY(other.Write("ex", "rk", "after"));
+    QCOMPARE(reader.ReadAvailable(), 1);
+    QCOMPARE(spy.at(0).at(2).toByteArray(), QByteArray("after"));
+}
+
+void tst_QMqShmRing::dropNewKeepsUnreadData()
+{
+    QString key = MakeKey("drop");
+    QMqShmRing writer;
+    QVERIFY(writer.CreateWriter(key, 4096, MqShmDropNew));
+    QMqShmRing reader;
+    QVERIFY(reader.AttachReader(key));
+
+    // 读端不读时写满即开始丢弃新消息
+    QByteArray body(512, 'x');
+    int written = 0;
+    while (writer.Write("ex", "rk", body)) {
+        written++;
+        QVERIFY(written < 100);
+    }
+    QVERIFY(written > 0);
+    QCOMPARE(writer.getStats().writeDropped.load(), (uint64_t)1);
+
+    QCOMPARE(reader.ReadAvailable(), written);
+    QCOMPARE(reader.getStats().overruns.load(), (uint64_t)0);
+    QVERIFY(writer.Write("ex", "rk", body));
+}
+
+QTEST_GUILESS_MAIN(tst_QMqShmRing)
+
+#include "tst_qmqshmring.moc"
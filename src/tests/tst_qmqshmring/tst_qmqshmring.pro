@@ -0,0 +1,11 @@
+include(../tests.pri)
+
+TARGET = tst_qmqshmring
+
+SOURCES += \
+    $$MQ_DIR/QMqShmRing.cpp \
+    tst_qmqshmring.cpp
+
+HEADERS += \
+    $$MQ_DIR/QMqShmRing.h \
+    $$MQ_DIR/QMqStats.h
@@ -0,0 +1,136 @@
+#include <QtTest>
+#include <openssl/ssl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <thread>
+#include "QMqBusyPollHandler.h"
+#include "QMqKtlsHandler.h"
+
+using namespace AMQP_QT;
+
+
+// 基类不实现monitor，测试中不需要事件循环
+class KtlsHandler : public QMqKtlsHandler
+{
+public:
+    using QMqKtlsHandler::QMqKtlsHandler;
+    void monitor(AMQP::TcpConnection *, int, int) override {}
+};
+
+// 其余回调使用TcpHandler的默认实现
+class BusyPollHandler : public QMqBusyPollHandler
+{
+public:
+    using QMqBusyPollHandler::QMqBusyPollHandler;
+};
+
+class tst_QMqTcpHandlers : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void ktlsOptionSet();
+    void ktlsDisabled();
+    void ktlsSecuredWithoutKernel();
+    void busyPollNegotiate();
+    void busyPollLoopWithoutWatches();
+    void busyPollIdleUntilStop();
+
+private:
+    SSL_CTX *m_ctx = nullptr;
+};
+
+void tst_QMqTcpHandlers::initTestCase()
+{
+    m_ctx = SSL_CTX_new(TLS_client_method());
+    QVERIFY(m_ctx != nullptr);
+}
+
+void tst_QMqTcpHandlers::cleanupTestCase()
+{
+    SSL_CTX_free(m_ctx);
+}
+
+void tst_QMqTcpHandlers::ktlsOptionSet()
+{
+    KtlsHandler handler;
+    SSL *ssl = SSL_new(m_ctx);
+    QVERIFY(handler.onSecuring(nullptr, ssl));
+#ifdef SSL_OP_ENABLE_KTLS
+    QVERIFY((SSL_get_options(ssl) & SSL_OP_ENABLE_KTLS) != 0);
+#endif
+    SSL_free(ssl);
+}
+
+void tst_QMqTcpHandlers::ktlsDisabled()
+{
+    KtlsHandler handler(false);
+    SSL *ssl = SSL_new(m_ctx);
+    QVERIFY(handler.onSecuring(nullptr, ssl));
+#ifdef SSL_OP_ENABLE_KTLS
+    QVERIFY((SSL_get_options(ssl) & SSL_OP_ENABLE_KTLS) == 0);
+#endif
+    SSL_free(ssl);
+}
+
+void tst_QMqTcpHandlers::ktlsSecuredWithoutKernel()
+{
+    // 内存BIO不是socket，内核加密不可能生效，应退回用户态
+    KtlsHandler handler;
+    SSL *ssl = SSL_new(m_ctx);
+    SSL_set_bio(ssl, BIO_new(BIO_s_mem()), BIO_new(BIO_s_mem()));
+    QVERIFY(handler.onSecuring(nullptr, ssl));
+    QVERIFY(handler.onSecured(nullptr, ssl));
+    QVERIFY(!handler.isKernelTlsSend());
+    QVERIFY(!handler.isKernelTlsRecv());
+    SSL_free(ssl);
+}
+
+void tst_QMqTcpHandlers::busyPollNegotiate()
+{
+    BusyPollHandler handler;
+    QCOMPARE(handler.onNegotiate(nullptr, 60), (uint16_t)60);
+    // broker不要求心跳时关闭
+    QCOMPARE(handler.onNegotiate(nullptr, 0), (uint16_t)0);
+}
+
+void tst_QMqTcpHandlers::busyPollLoopWithoutWatches()
+{
+    // 没有需要监听的socket时Loop立即返回
+    BusyPollHandler handler;
+    handler.Loop();
+    QCOMPARE(handler.getStats().idleSpins.load(), (uint64_t)0);
+}
+
+void tst_QMqTcpHandlers::busyPollIdleUntilStop()
+{
+    int fds[2];
+    QCOMPARE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    MqBusyPollConfig config;
+    config.spinUs = 10;
+    config.blockTimeoutMs = 10;
+    BusyPollHandler handler(config);
+    // 对端不写数据，socket一直没有事件，不会调用到连接对象
+    handler.monitor(nullptr, fds[0], AMQP::readable);
+
+    std::thread loop([&handler]() { handler.Loop(); });
+    QTest::qWait(50);
+    handler.Stop();
+    loop.join();
+    QVERIFY(handler.getStats().idleSpins.load() > 0);
+    QCOMPARE(handler.getStats().spinWakeups.load(), (uint64_t)0);
+
+    // 取消监听后Loop立即返回
+    handler.monitor(nullptr, fds[0], 0);
+    handler.Loop();
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+QTEST_GUILESS_MAIN(tst_QMqTcpHandlers)
+
+#include "tst_qmqtcphandlers.moc"
@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+TARGET = tst_qmqtcphandlers
+
+# linux_tcp模块的TcpHandler只在Linux下可用，依赖系统安装的AMQP-CPP(编译时启用linux_tcp)和OpenSSL
+LIBS += -lamqpcpp -lssl -lcrypto -lpthread -ldl
+
+SOURCES += \
+    tst_qmqtcphandlers.cpp
+
+HEADERS += \
+    $$MQ_DIR/QMqBusyPollHandler.h \
+    $$MQ_DIR/QMqKtlsHandler.h
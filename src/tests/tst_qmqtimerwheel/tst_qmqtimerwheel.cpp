@@ -0,0 +1,98 @@
+#include <QtTest>
+#include "QMqTimerWheel.h"
+
+using namespace AMQP_QT;
+
+
+class tst_QMqTimerWheel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void expiresAfterDelay();
+    void zeroDelayWaitsOneTick();
+    void cancel();
+    void rescheduleDropsStaleEntry();
+    void cascadeFromUpperLevel();
+    void scheduleAfterIdle();
+};
+
+void tst_QMqTimerWheel::expiresAfterDelay()
+{
+    QMqTimerWheel wheel(10);
+    wheel.schedule(1, 30);
+    wheel.schedule(2, 5);
+    QCOMPARE(wheel.size(), 2);
+
+    // 不足一个tick的延迟向上取整
+    QVERIFY(wheel.advance(9).isEmpty());
+    QCOMPARE(wheel.advance(10), QList<uint64_t>({ 2 }));
+    QVERIFY(wheel.advance(29).isEmpty());
+    QCOMPARE(wheel.advance(30), QList<uint64_t>({ 1 }));
+    QVERIFY(wheel.isEmpty());
+    QCOMPARE(wheel.nextExpireMs(), (qint64)-1);
+}
+
+void tst_QMqTimerWheel::zeroDelayWaitsOneTick()
+{
+    QMqTimerWheel wheel(10);
+    wheel.schedule(1, 0);
+    QVERIFY(wheel.advance(0).isEmpty());
+    QCOMPARE(wheel.advance(10), QList<uint64_t>({ 1 }));
+}
+
+void tst_QMqTimerWheel::cancel()
+{
+    QMqTimerWheel wheel(10);
+    wheel.schedule(1, 50);
+    QVERIFY(wheel.cancel(1));
+    QVERIFY(!wheel.cancel(1));
+    QVERIFY(wheel.isEmpty());
+    QVERIFY(wheel.advance(100).isEmpty());
+}
+
+void tst_QMqTimerWheel::rescheduleDropsStaleEntry()
+{
+    QMqTimerWheel wheel(10);
+    wheel.schedule(1, 20);
+    wheel.schedule(1, 20);
+    wheel.schedule(2, 20);
+    wheel.schedule(2, 100);
+    QCOMPARE(wheel.size(), 2);
+
+    // 同一id重复添加只到期一次，推迟后原来的槽不再触发
+    QCOMPARE(wheel.advance(20), QList<uint64_t>({ 1 }));
+    QVERIFY(wheel.advance(90).isEmpty());
+    QCOMPARE(wheel.advance(100), QList<uint64_t>({ 2 }));
+    QVERIFY(wheel.isEmpty());
+}
+
+void tst_QMqTimerWheel::cascadeFromUpperLevel()
+{
+    QMqTimerWheel wheel(1);
+    wheel.schedule(1, 5000);
+
+    // 第2层的槽只精确到槽的起始时间，下放后才能得到准确的到期时间
+    QCOMPARE(wheel.nextExpireMs(), (qint64)4096);
+    QVERIFY(wheel.advance(4999).isEmpty());
+    QCOMPARE(wheel.nextExpireMs(), (qint64)5000);
+    QCOMPARE(wheel.advance(5000), QList<uint64_t>({ 1 }));
+}
+
+void tst_QMqTimerWheel::scheduleAfterIdle()
+{
+    QMqTimerWheel wheel(10);
+    wheel.schedule(1, 10);
+    QCOMPARE(wheel.advance(10), QList<uint64_t>({ 1 }));
+
+    // 空闲期间时间轮不推进，当前tick停在上一次advance的时间；
+    // 添加定时器前先推进到当前时间，否则延迟从旧tick算起，会提前到期
+    QVERIFY(wheel.advance(1000).isEmpty());
+    wheel.schedule(2, 100);
+    QVERIFY(wheel.advance(1090).isEmpty());
+    QCOMPARE(wheel.advance(1100), QList<uint64_t>({ 2 }));
+}
+
+QTEST_GUILESS_MAIN(tst_QMqTimerWheel)
+
+#include "tst_qmqtimerwheel.moc"
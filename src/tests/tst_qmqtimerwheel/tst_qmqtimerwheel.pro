@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_qmqtimerwheel
+
+SOURCES += \
+    $$MQ_DIR/QMqTimerWheel.cpp \
+    tst_qmqtimerwheel.cpp
+
+HEADERS += \
+    $$MQ_DIR/QMqTimerWheel.h